@@ -0,0 +1,178 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "include/SDL2/SDL.h"
+#include "include/SDL2/SDL_ttf.h"
+
+// Allocation counters for the instrumentation build.
+// Compile with -DALLOC_TRACKING to count, per frame, every malloc/calloc/realloc
+// made by the game, every allocation SDL, SDL_ttf and SDL_mixer make through
+// SDL's allocator, and every texture or surface the game creates. Frames in
+// the steady state (the play phase after a warm-up) must not allocate at all:
+// offending frames are printed and the game exits with a non-zero code.
+// Include this header before the other modules so their calls are counted.
+// Without ALLOC_TRACKING every function is an empty stub.
+
+#define ALLOC_TRACKER_WARMUP_FRAMES 120
+#define ALLOC_TRACKER_REPORT_LIMIT 10
+
+#ifdef ALLOC_TRACKING
+
+struct Alloc_Tracker
+{
+    // Written from any thread
+    SDL_atomic_t heap_count;
+    SDL_atomic_t sdl_count;
+    SDL_atomic_t object_count;
+
+    // Counter values at the end of the previous frame
+    int last_heap_count;
+    int last_sdl_count;
+    int last_object_count;
+
+    int frame_count;
+    int steady_frame_count;
+    int steady_allocating_frame_count;
+
+    SDL_malloc_func sdl_malloc;
+    SDL_calloc_func sdl_calloc;
+    SDL_realloc_func sdl_realloc;
+    SDL_free_func sdl_free;
+};
+
+static struct Alloc_Tracker alloc_tracker;
+
+static void *alloc_tracker_malloc(size_t size)
+{
+    SDL_AtomicIncRef(&alloc_tracker.heap_count);
+    return malloc(size);
+}
+
+static void *alloc_tracker_calloc(size_t count, size_t size)
+{
+    SDL_AtomicIncRef(&alloc_tracker.heap_count);
+    return calloc(count, size);
+}
+
+static void *alloc_tracker_realloc(void *memory, size_t size)
+{
+    SDL_AtomicIncRef(&alloc_tracker.heap_count);
+    return realloc(memory, size);
+}
+
+static void *SDLCALL alloc_tracker_sdl_malloc(size_t size)
+{
+    SDL_AtomicIncRef(&alloc_tracker.sdl_count);
+    return alloc_tracker.sdl_malloc(size);
+}
+
+static void *SDLCALL alloc_tracker_sdl_calloc(size_t count, size_t size)
+{
+    SDL_AtomicIncRef(&alloc_tracker.sdl_count);
+    return alloc_tracker.sdl_calloc(count, size);
+}
+
+static void *SDLCALL alloc_tracker_sdl_realloc(void *memory, size_t size)
+{
+    SDL_AtomicIncRef(&alloc_tracker.sdl_count);
+    return alloc_tracker.sdl_realloc(memory, size);
+}
+
+static void SDLCALL alloc_tracker_sdl_free(void *memory)
+{
+    alloc_tracker.sdl_free(memory);
+}
+
+// Function to count one texture or surface creation, passes the object through
+static void *alloc_tracker_object(void *object)
+{
+    SDL_AtomicIncRef(&alloc_tracker.object_count);
+    return object;
+}
+
+#define malloc(size) alloc_tracker_malloc(size)
+#define calloc(count, size) alloc_tracker_calloc(count, size)
+#define realloc(memory, size) alloc_tracker_realloc(memory, size)
+
+#define SDL_CreateTexture(...) ((SDL_Texture *)alloc_tracker_object(SDL_CreateTexture(__VA_ARGS__)))
+#define SDL_CreateTextureFromSurface(...) ((SDL_Texture *)alloc_tracker_object(SDL_CreateTextureFromSurface(__VA_ARGS__)))
+#define SDL_CreateRGBSurfaceWithFormat(...) ((SDL_Surface *)alloc_tracker_object(SDL_CreateRGBSurfaceWithFormat(__VA_ARGS__)))
+#define TTF_RenderGlyph32_Blended(...) ((SDL_Surface *)alloc_tracker_object(TTF_RenderGlyph32_Blended(__VA_ARGS__)))
+
+// Function to route SDL's allocations through the counters
+// Has to run before any other SDL call.
+static void alloc_tracker_install(void)
+{
+    SDL_GetMemoryFunctions(&alloc_tracker.sdl_malloc, &alloc_tracker.sdl_calloc, &alloc_tracker.sdl_realloc, &alloc_tracker.sdl_free);
+    SDL_SetMemoryFunctions(alloc_tracker_sdl_malloc, alloc_tracker_sdl_calloc, alloc_tracker_sdl_realloc, alloc_tracker_sdl_free);
+}
+
+// Function to close the counting window of one frame
+// - steady: true if the frame is in the steady state and must not allocate
+static void alloc_tracker_end_frame(bool steady)
+{
+    int heap_count = SDL_AtomicGet(&alloc_tracker.heap_count);
+    int sdl_count = SDL_AtomicGet(&alloc_tracker.sdl_count);
+    int object_count = SDL_AtomicGet(&alloc_tracker.object_count);
+
+    int heap = heap_count - alloc_tracker.last_heap_count;
+    int sdl = sdl_count - alloc_tracker.last_sdl_count;
+    int objects = object_count - alloc_tracker.last_object_count;
+    alloc_tracker.last_heap_count = heap_count;
+    alloc_tracker.last_sdl_count = sdl_count;
+    alloc_tracker.last_object_count = object_count;
+
+    if (steady)
+    {
+        ++alloc_tracker.steady_frame_count;
+        if (heap || sdl || objects)
+        {
+            if (alloc_tracker.steady_allocating_frame_count < ALLOC_TRACKER_REPORT_LIMIT)
+            {
+                printf("alloc: frame %d allocated in steady state: %d heap, %d SDL, %d objects\n",
+                       alloc_tracker.frame_count, heap, sdl, objects);
+            }
+            ++alloc_tracker.steady_allocating_frame_count;
+        }
+    }
+    ++alloc_tracker.frame_count;
+}
+
+// Function to print the totals
+// - returns false if any steady state frame allocated
+static bool alloc_tracker_report(FILE *out)
+{
+    fprintf(out, "alloc: %d heap, %d SDL, %d objects over %d frames, %d of %d steady state frames allocated\n",
+            SDL_AtomicGet(&alloc_tracker.heap_count),
+            SDL_AtomicGet(&alloc_tracker.sdl_count),
+            SDL_AtomicGet(&alloc_tracker.object_count),
+            alloc_tracker.frame_count,
+            alloc_tracker.steady_allocating_frame_count,
+            alloc_tracker.steady_frame_count);
+    return alloc_tracker.steady_allocating_frame_count == 0;
+}
+
+#else
+
+static void alloc_tracker_install(void)
+{
+}
+
+static void alloc_tracker_end_frame(bool steady)
+{
+    (void)steady;
+}
+
+static bool alloc_tracker_report(FILE *out)
+{
+    (void)out;
+    return true;
+}
+
+#endif
+
+#endif
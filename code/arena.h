@@ -0,0 +1,187 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Bump-pointer arena for short-lived search nodes.
+// One arena is owned by one search thread, so nothing here takes a lock.
+// Memory is handed out from a chain of blocks that are kept across resets:
+// after the first few moves a search runs without touching malloc at all.
+
+#define ARENA_DEFAULT_BLOCK_SIZE (1024 * 1024)
+#define ARENA_ALIGNMENT 16
+
+struct Arena_Block
+{
+    struct Arena_Block *next;
+    size_t capacity;
+    size_t used;
+    unsigned char *data;
+};
+
+struct Arena_Stats
+{
+    size_t used_bytes;
+    size_t peak_bytes;
+    size_t reserved_bytes;
+    size_t node_count;
+    size_t peak_node_count;
+    size_t block_count;
+    size_t reset_count;
+};
+
+struct Arena
+{
+    struct Arena_Block *first;
+    struct Arena_Block *current;
+    size_t block_size;
+
+    // Bytes handed out from blocks before the current one since the last reset
+    size_t retired_bytes;
+
+    struct Arena_Stats stats;
+};
+
+static struct Arena_Block *arena_block_create(size_t capacity)
+{
+    // Block header and payload come from a single allocation
+    size_t header_size = (sizeof(struct Arena_Block) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    struct Arena_Block *block = (struct Arena_Block *)malloc(header_size + capacity);
+    if (!block)
+    {
+        return 0;
+    }
+    block->next = 0;
+    block->capacity = capacity;
+    block->used = 0;
+    block->data = (unsigned char *)block + header_size;
+    return block;
+}
+
+// Function to initialize an arena
+// - arena: arena to initialize
+// - block_size: size of each block, 0 selects ARENA_DEFAULT_BLOCK_SIZE
+// - returns false if the first block could not be allocated
+static bool arena_init(struct Arena *arena, size_t block_size)
+{
+    memset(arena, 0, sizeof(*arena));
+    arena->block_size = block_size ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+    arena->first = arena_block_create(arena->block_size);
+    if (!arena->first)
+    {
+        return false;
+    }
+    arena->current = arena->first;
+    arena->stats.block_count = 1;
+    arena->stats.reserved_bytes = arena->block_size;
+    return true;
+}
+
+// Function to release every block owned by the arena
+static void arena_free(struct Arena *arena)
+{
+    struct Arena_Block *block = arena->first;
+    while (block)
+    {
+        struct Arena_Block *next = block->next;
+        free(block);
+        block = next;
+    }
+    memset(arena, 0, sizeof(*arena));
+}
+
+// Function to allocate uninitialized memory from the arena
+// - arena: arena to allocate from
+// - size: number of bytes requested
+// - returns 16-byte aligned memory, or 0 if the system is out of memory
+static void *arena_push(struct Arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    struct Arena_Block *block = arena->current;
+    while (block->used + size > block->capacity)
+    {
+        // Move on to a block kept from an earlier move, or grow the chain
+        arena->retired_bytes += block->used;
+        if (!block->next)
+        {
+            size_t capacity = size > arena->block_size ? size : arena->block_size;
+            block->next = arena_block_create(capacity);
+            if (!block->next)
+            {
+                arena->retired_bytes -= block->used;
+                return 0;
+            }
+            ++arena->stats.block_count;
+            arena->stats.reserved_bytes += capacity;
+        }
+        block = block->next;
+        block->used = 0;
+        arena->current = block;
+    }
+
+    void *result = block->data + block->used;
+    block->used += size;
+
+    size_t used_bytes = arena->retired_bytes + block->used;
+    arena->stats.used_bytes = used_bytes;
+    if (used_bytes > arena->stats.peak_bytes)
+    {
+        arena->stats.peak_bytes = used_bytes;
+    }
+    return result;
+}
+
+// Function to allocate one search node and count it in the node statistics
+// - arena: arena to allocate from
+// - size: size of the node structure
+static void *arena_push_node(struct Arena *arena, size_t size)
+{
+    void *node = arena_push(arena, size);
+    if (node)
+    {
+        ++arena->stats.node_count;
+        if (arena->stats.node_count > arena->stats.peak_node_count)
+        {
+            arena->stats.peak_node_count = arena->stats.node_count;
+        }
+    }
+    return node;
+}
+
+#define ARENA_PUSH_ARRAY(arena, type, count) ((type *)arena_push((arena), sizeof(type) * (count)))
+#define ARENA_PUSH_NODE(arena, type) ((type *)arena_push_node((arena), sizeof(type)))
+
+// Function to drop everything allocated since the last reset in O(1)
+// Call it when a piece locks: every node of the previous search is dead by then.
+static void arena_reset(struct Arena *arena)
+{
+    arena->current = arena->first;
+    arena->first->used = 0;
+    arena->retired_bytes = 0;
+    arena->stats.used_bytes = 0;
+    arena->stats.node_count = 0;
+    ++arena->stats.reset_count;
+}
+
+// Function to print the arena statistics
+// - arena: arena to report on
+// - name: label printed in front of the numbers
+// - out: stream to print to
+static void arena_print_stats(const struct Arena *arena, const char *name, FILE *out)
+{
+    const struct Arena_Stats *stats = &arena->stats;
+    fprintf(out, "%s: peak %zu bytes, %zu nodes peak, %zu bytes reserved in %zu blocks, %zu resets\n",
+            name,
+            stats->peak_bytes,
+            stats->peak_node_count,
+            stats->reserved_bytes,
+            stats->block_count,
+            stats->reset_count);
+}
+
+#endif
@@ -0,0 +1,231 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifndef ASSET_PACK_NO_SDL
+#include "include/SDL2/SDL.h"
+#endif
+
+// Read-only archive holding every asset of the game.
+// The pack is a header, an index of named entries and the file contents, all
+// little-endian (see pack_assets.c, which builds it). At runtime the whole file
+// is memory-mapped with one open and assets are handed to SDL as
+// SDL_RWFromConstMem streams over the mapping, so nothing is copied or read
+// until a decoder touches it. The same bytes can be linked into the binary
+// instead; assets that are not in the pack are opened as loose files.
+// pack_assets.c defines ASSET_PACK_NO_SDL to use the format and the reader
+// without SDL.
+//
+//   header  "TPAK", u32 version, u32 entry count, u32 reserved
+//   entry   char name[56], u32 offset, u32 size   (entry count times)
+//   data    file contents, each starting on a 16 byte boundary
+
+#define ASSET_PACK_MAGIC "TPAK"
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_HEADER_SIZE 16
+#define ASSET_PACK_NAME_SIZE 56
+#define ASSET_PACK_ENTRY_SIZE 64
+#define ASSET_PACK_ALIGNMENT 16
+
+struct Asset_Pack
+{
+    const unsigned char *data;
+    size_t size;
+    uint32_t entry_count;
+
+    // Set when `data` is a mapping owned by the pack
+    bool mapped;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+static uint32_t asset_pack_read_u32(const unsigned char *bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+// Function to check a pack in memory and use it
+// - pack: pack to initialize
+// - data, size: contents of a pack file, must stay valid while the pack is used
+// - returns false if the data is not a valid pack
+static bool asset_pack_open_memory(struct Asset_Pack *pack, const void *data, size_t size)
+{
+    memset(pack, 0, sizeof(*pack));
+    const unsigned char *bytes = (const unsigned char *)data;
+    if (size < ASSET_PACK_HEADER_SIZE || memcmp(bytes, ASSET_PACK_MAGIC, 4) != 0 ||
+        asset_pack_read_u32(bytes + 4) != ASSET_PACK_VERSION)
+    {
+        return false;
+    }
+
+    uint32_t entry_count = asset_pack_read_u32(bytes + 8);
+    if (entry_count > (size - ASSET_PACK_HEADER_SIZE) / ASSET_PACK_ENTRY_SIZE)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < entry_count; ++i)
+    {
+        const unsigned char *entry = bytes + ASSET_PACK_HEADER_SIZE + i * ASSET_PACK_ENTRY_SIZE;
+        uint32_t offset = asset_pack_read_u32(entry + ASSET_PACK_NAME_SIZE);
+        uint32_t entry_size = asset_pack_read_u32(entry + ASSET_PACK_NAME_SIZE + 4);
+        if (entry[ASSET_PACK_NAME_SIZE - 1] != 0 || offset > size || entry_size > size - offset)
+        {
+            return false;
+        }
+    }
+
+    pack->data = bytes;
+    pack->size = size;
+    pack->entry_count = entry_count;
+    return true;
+}
+
+// Function to memory-map a pack file
+// - pack: pack to initialize
+// - filename: path of the pack
+// - returns false if the file is missing or not a valid pack
+static bool asset_pack_open(struct Asset_Pack *pack, const char *filename)
+{
+    memset(pack, 0, sizeof(*pack));
+    const void *data = 0;
+    size_t size = 0;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    HANDLE mapping = GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0
+                         ? CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0)
+                         : 0;
+    if (mapping)
+    {
+        data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        size = (size_t)file_size.QuadPart;
+    }
+    if (!data)
+    {
+        if (mapping)
+        {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return false;
+    }
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        size = (size_t)info.st_size;
+        data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        data = data == MAP_FAILED ? 0 : data;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    if (!data)
+    {
+        return false;
+    }
+#endif
+
+    if (!asset_pack_open_memory(pack, data, size))
+    {
+        printf("%s is not a valid asset pack\n", filename);
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(mapping);
+        CloseHandle(file);
+#else
+        munmap((void *)data, size);
+#endif
+        return false;
+    }
+
+    pack->mapped = true;
+#ifdef _WIN32
+    pack->file = file;
+    pack->mapping = mapping;
+#endif
+    return true;
+}
+
+// Function to unmap the pack, streams opened from it must be closed first
+static void asset_pack_close(struct Asset_Pack *pack)
+{
+    if (pack->mapped)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(pack->data);
+        CloseHandle(pack->mapping);
+        CloseHandle(pack->file);
+#else
+        munmap((void *)pack->data, pack->size);
+#endif
+    }
+    memset(pack, 0, sizeof(*pack));
+}
+
+// Function to look up an asset by name
+// - pack: the pack, may be empty
+// - name: name the asset was packed under, e.g. "sounds/clear.wav"
+// - size: receives the size of the asset
+// - returns the contents, or 0 if the pack has no such asset
+static const void *asset_pack_find(const struct Asset_Pack *pack, const char *name, size_t *size)
+{
+    for (uint32_t i = 0; i < pack->entry_count; ++i)
+    {
+        const unsigned char *entry = pack->data + ASSET_PACK_HEADER_SIZE + i * ASSET_PACK_ENTRY_SIZE;
+        if (strcmp((const char *)entry, name) == 0)
+        {
+            *size = asset_pack_read_u32(entry + ASSET_PACK_NAME_SIZE + 4);
+            return pack->data + asset_pack_read_u32(entry + ASSET_PACK_NAME_SIZE);
+        }
+    }
+    return 0;
+}
+
+#ifndef ASSET_PACK_NO_SDL
+// Function to open an asset as an SDL stream
+// Assets missing from the pack are opened as loose files relative to the working directory.
+// - returns the stream, or 0 if the asset was found nowhere
+static SDL_RWops *asset_pack_open_rw(const struct Asset_Pack *pack, const char *name)
+{
+    size_t size = 0;
+    const void *data = asset_pack_find(pack, name, &size);
+    if (data)
+    {
+        return SDL_RWFromConstMem(data, (int)size);
+    }
+    return SDL_RWFromFile(name, "rb");
+}
+#endif
+
+#endif
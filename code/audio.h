@@ -0,0 +1,122 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "include/SDL2/SDL.h"
+#include "include/SDL2/SDL_mixer.h"
+
+#include "trace.h"
+
+// Audio events and the subsystem that plays them.
+// The engine never calls SDL_mixer; it raises AUDIO_EVENT bits on the frame
+// something happens, and the frontend hands the collected bits to audio_play
+// once per update. Raising an event twice before it is played has no extra
+// effect, and every event maps to a single mixer call (pausing takes two, one
+// for the channels and one for the music). The theme and the game over jingle
+// are streamed as music, so starting one replaces the other and neither is
+// ever decoded into memory as a whole; sound effects are decoded chunks,
+// converted to the device format once at load, and are dropped when all
+// channels are busy. Sounds may arrive from a loading thread after the game
+// started; events raised before that are dropped and the game stays silent.
+
+#define AUDIO_CHANNEL_COUNT 4
+
+enum Audio_Event
+{
+    AUDIO_EVENT_GAME_START,
+    AUDIO_EVENT_LINE_CLEAR,
+    AUDIO_EVENT_GAME_OVER,
+    AUDIO_EVENT_PAUSE,
+    AUDIO_EVENT_RESUME,
+
+    AUDIO_EVENT_COUNT
+};
+
+struct Audio
+{
+    // Set once the sounds below are loaded
+    SDL_atomic_t ready;
+
+    Mix_Music *theme;
+    Mix_Music *game_over;
+    Mix_Chunk *line_clear;
+
+    // Number of events played
+    int played_event_count;
+};
+
+// Function to set up a silent audio subsystem
+static void audio_init(struct Audio *audio)
+{
+    memset(audio, 0, sizeof(*audio));
+}
+
+// Function to hand the loaded sounds over, may run on any thread
+// - audio: the audio subsystem
+// - theme, game_over: music to stream, either may be 0
+// - line_clear: sound effect, may be 0
+static void audio_set_sounds(struct Audio *audio, Mix_Music *theme, Mix_Music *game_over, Mix_Chunk *line_clear)
+{
+    audio->theme = theme;
+    audio->game_over = game_over;
+    audio->line_clear = line_clear;
+    Mix_AllocateChannels(AUDIO_CHANNEL_COUNT);
+
+    // SDL_AtomicSet is a full barrier, the sounds are visible before the flag
+    SDL_AtomicSet(&audio->ready, 1);
+}
+
+// Function to play the events raised since the last call
+// - audio: the audio subsystem
+// - events: AUDIO_EVENT bits, each set bit is played once
+static void audio_play(struct Audio *audio, unsigned events)
+{
+    if (!SDL_AtomicGet(&audio->ready))
+    {
+        return;
+    }
+
+    for (int event = 0; events && event < AUDIO_EVENT_COUNT; ++event)
+    {
+        if (!(events & (1u << event)))
+        {
+            continue;
+        }
+        events &= ~(1u << event);
+
+        switch (event)
+        {
+        case AUDIO_EVENT_GAME_START:
+            if (audio->theme)
+            {
+                TRACE_CALL(TRACE_COUNTER_MIXER_CALLS, Mix_PlayMusic(audio->theme, -1));
+            }
+            break;
+        case AUDIO_EVENT_LINE_CLEAR:
+            if (audio->line_clear)
+            {
+                TRACE_CALL(TRACE_COUNTER_MIXER_CALLS, Mix_PlayChannel(-1, audio->line_clear, 0));
+            }
+            break;
+        case AUDIO_EVENT_GAME_OVER:
+            if (audio->game_over)
+            {
+                TRACE_CALL(TRACE_COUNTER_MIXER_CALLS, Mix_PlayMusic(audio->game_over, 0));
+            }
+            break;
+        case AUDIO_EVENT_PAUSE:
+            TRACE_CALL(TRACE_COUNTER_MIXER_CALLS, Mix_Pause(-1));
+            TRACE_CALL(TRACE_COUNTER_MIXER_CALLS, Mix_PauseMusic());
+            break;
+        case AUDIO_EVENT_RESUME:
+            TRACE_CALL(TRACE_COUNTER_MIXER_CALLS, Mix_Resume(-1));
+            TRACE_CALL(TRACE_COUNTER_MIXER_CALLS, Mix_ResumeMusic());
+            break;
+        }
+        ++audio->played_event_count;
+    }
+}
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Playfield with runtime width and height.
+// Rows are addressed through a row table: logical row -> physical row in `cells`.
+// Clearing lines only moves row indices and zeroes the cleared rows, the cell
+// data of the surviving rows is never copied. Every physical row also keeps an
+// occupancy bitmask, which turns the filled/empty row tests into one compare.
+
+#define BOARD_STANDARD_WIDTH 10
+#define BOARD_STANDARD_HEIGHT 22
+#define BOARD_HIDDEN_ROWS 2
+
+#define BOARD_MIN_WIDTH 4
+#define BOARD_MAX_WIDTH 16
+#define BOARD_MIN_HEIGHT (BOARD_HIDDEN_ROWS + 4)
+#define BOARD_MAX_HEIGHT 1024
+
+// Physical rows are always BOARD_MAX_WIDTH cells apart so indexing is a shift
+#define BOARD_STRIDE BOARD_MAX_WIDTH
+
+struct Board
+{
+    int width;
+    int height;
+
+    // Every row above stack_top is empty
+    int stack_top;
+
+    // Bumped on every change, lets renderers skip unchanged boards
+    uint32_t revision;
+
+    uint16_t full_mask;
+    uint16_t rows[BOARD_MAX_HEIGHT];
+    uint16_t masks[BOARD_MAX_HEIGHT];
+    unsigned char cells[BOARD_MAX_HEIGHT * BOARD_STRIDE];
+};
+
+// Function to empty the board and restore the identity row table
+static void board_clear(struct Board *board)
+{
+    for (int row = 0; row < board->height; ++row)
+    {
+        board->rows[row] = (uint16_t)row;
+    }
+    memset(board->masks, 0, sizeof(board->masks[0]) * board->height);
+    memset(board->cells, 0, BOARD_STRIDE * board->height);
+    board->stack_top = board->height;
+    ++board->revision;
+}
+
+// Function to set up an empty board
+// - board: board to initialize
+// - width, height: size of the playfield in cells
+// - returns false if the size is out of range
+static bool board_init(struct Board *board, int width, int height)
+{
+    if (width < BOARD_MIN_WIDTH || width > BOARD_MAX_WIDTH ||
+        height < BOARD_MIN_HEIGHT || height > BOARD_MAX_HEIGHT)
+    {
+        return false;
+    }
+
+    board->width = width;
+    board->height = height;
+    board->full_mask = (uint16_t)((1u << width) - 1);
+    board_clear(board);
+    return true;
+}
+
+static const unsigned char *board_row(const struct Board *board, int row)
+{
+    return board->cells + board->rows[row] * BOARD_STRIDE;
+}
+
+static uint16_t board_row_mask(const struct Board *board, int row)
+{
+    return board->masks[board->rows[row]];
+}
+
+static unsigned char board_get(const struct Board *board, int row, int col)
+{
+    return board->cells[board->rows[row] * BOARD_STRIDE + col];
+}
+
+static void board_set(struct Board *board, int row, int col, unsigned char value)
+{
+    int physical_row = board->rows[row];
+    board->cells[physical_row * BOARD_STRIDE + col] = value;
+    ++board->revision;
+    if (value)
+    {
+        board->masks[physical_row] |= (uint16_t)(1u << col);
+        if (row < board->stack_top)
+        {
+            board->stack_top = row;
+        }
+    }
+    else
+    {
+        board->masks[physical_row] &= (uint16_t)~(1u << col);
+    }
+}
+
+static bool board_row_filled(const struct Board *board, int row)
+{
+    return board_row_mask(board, row) == board->full_mask;
+}
+
+static bool board_row_empty(const struct Board *board, int row)
+{
+    return board_row_mask(board, row) == 0;
+}
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef BOARD_CORPUS_H
+#define BOARD_CORPUS_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "board.h"
+
+// Fixed set of boards the engine microbenchmarks run over.
+// The boards come from seeded self-play, but they are stored rather than
+// regenerated: self-play runs the engine itself, so an engine change would
+// otherwise change the boards it is measured on. The file is little-endian
+// and versioned; a reader refuses any other version.
+//
+//   header  "TBRD", u32 version, u32 board count, u32 width, u32 height, u32 seed
+//   board   u32 category, then width * height cells, one byte each, top row first
+
+#define BOARD_CORPUS_VERSION 1
+#define BOARD_CORPUS_HEADER_SIZE 24
+
+enum Board_Corpus_Category
+{
+    BOARD_CORPUS_EMPTY,
+    BOARD_CORPUS_RAGGED,
+    BOARD_CORPUS_NEAR_TOP_OUT,
+    BOARD_CORPUS_HOLES,
+
+    BOARD_CORPUS_CATEGORY_COUNT
+};
+
+static const char *BOARD_CORPUS_CATEGORY_NAMES[BOARD_CORPUS_CATEGORY_COUNT] = {"empty", "ragged", "near top-out", "many holes"};
+
+struct Board_Corpus
+{
+    int width;
+    int height;
+    uint32_t seed;
+
+    int count;
+    unsigned char *categories;
+    struct Board *boards;
+};
+
+// Function to allocate a corpus of empty boards
+// - corpus: corpus to initialize
+// - width, height: size of every board
+// - count: number of boards
+// - returns false if the size is invalid or out of memory
+static bool board_corpus_init(struct Board_Corpus *corpus, int width, int height, int count)
+{
+    memset(corpus, 0, sizeof(*corpus));
+    corpus->categories = (unsigned char *)calloc(count > 0 ? count : 1, 1);
+    corpus->boards = (struct Board *)malloc(sizeof(struct Board) * (count > 0 ? count : 1));
+    if (!corpus->categories || !corpus->boards)
+    {
+        return false;
+    }
+
+    corpus->width = width;
+    corpus->height = height;
+    corpus->count = count;
+    for (int i = 0; i < count; ++i)
+    {
+        if (!board_init(corpus->boards + i, width, height))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void board_corpus_free(struct Board_Corpus *corpus)
+{
+    free(corpus->categories);
+    free(corpus->boards);
+    memset(corpus, 0, sizeof(*corpus));
+}
+
+static void board_corpus_write_u32(FILE *file, uint32_t value)
+{
+    unsigned char bytes[4] = {(unsigned char)value, (unsigned char)(value >> 8), (unsigned char)(value >> 16), (unsigned char)(value >> 24)};
+    fwrite(bytes, 1, 4, file);
+}
+
+static uint32_t board_corpus_read_u32(const unsigned char *bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+// Function to write a corpus file
+// - returns false if the file could not be written
+static bool board_corpus_write(const struct Board_Corpus *corpus, const char *filename)
+{
+    FILE *file = fopen(filename, "wb");
+    if (!file)
+    {
+        printf("Failed to open %s\n", filename);
+        return false;
+    }
+
+    fwrite("TBRD", 1, 4, file);
+    board_corpus_write_u32(file, BOARD_CORPUS_VERSION);
+    board_corpus_write_u32(file, (uint32_t)corpus->count);
+    board_corpus_write_u32(file, (uint32_t)corpus->width);
+    board_corpus_write_u32(file, (uint32_t)corpus->height);
+    board_corpus_write_u32(file, corpus->seed);
+
+    for (int i = 0; i < corpus->count; ++i)
+    {
+        const struct Board *board = corpus->boards + i;
+        board_corpus_write_u32(file, corpus->categories[i]);
+        for (int row = 0; row < board->height; ++row)
+        {
+            fwrite(board_row(board, row), 1, board->width, file);
+        }
+    }
+
+    bool written = !ferror(file);
+    fclose(file);
+    if (!written)
+    {
+        printf("Failed to write %s\n", filename);
+    }
+    return written;
+}
+
+// Function to read a corpus file
+// - corpus: corpus to initialize, freed with board_corpus_free
+// - returns false if the file is missing, of another version or malformed
+static bool board_corpus_read(struct Board_Corpus *corpus, const char *filename)
+{
+    memset(corpus, 0, sizeof(*corpus));
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+    {
+        printf("Failed to open board corpus: %s\n", filename);
+        return false;
+    }
+
+    unsigned char header[BOARD_CORPUS_HEADER_SIZE];
+    bool valid = fread(header, 1, sizeof(header), file) == sizeof(header) && memcmp(header, "TBRD", 4) == 0;
+    if (valid && board_corpus_read_u32(header + 4) != BOARD_CORPUS_VERSION)
+    {
+        printf("%s is board corpus version %u, expected %d\n", filename, board_corpus_read_u32(header + 4), BOARD_CORPUS_VERSION);
+        valid = false;
+    }
+
+    uint32_t count = valid ? board_corpus_read_u32(header + 8) : 0;
+    uint32_t width = valid ? board_corpus_read_u32(header + 12) : 0;
+    uint32_t height = valid ? board_corpus_read_u32(header + 16) : 0;
+    valid = valid && count <= 65536 && board_corpus_init(corpus, (int)width, (int)height, (int)count);
+    corpus->seed = valid ? board_corpus_read_u32(header + 20) : 0;
+
+    unsigned char cells[BOARD_MAX_WIDTH];
+    for (int i = 0; valid && i < corpus->count; ++i)
+    {
+        unsigned char category[4];
+        valid = fread(category, 1, 4, file) == 4 && board_corpus_read_u32(category) < BOARD_CORPUS_CATEGORY_COUNT;
+        corpus->categories[i] = valid ? category[0] : 0;
+
+        struct Board *board = corpus->boards + i;
+        for (int row = 0; valid && row < board->height; ++row)
+        {
+            valid = fread(cells, 1, board->width, file) == (size_t)board->width;
+            for (int col = 0; valid && col < board->width; ++col)
+            {
+                if (cells[col])
+                {
+                    board_set(board, row, col, cells[col]);
+                }
+            }
+        }
+    }
+    fclose(file);
+
+    if (!valid)
+    {
+        printf("%s is not a valid board corpus\n", filename);
+        board_corpus_free(corpus);
+    }
+    return valid;
+}
+
+#endif
@@ -0,0 +1,302 @@
+#ifndef FONT_ATLAS_H
+#define FONT_ATLAS_H
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "include/SDL2/SDL.h"
+#include "include/SDL2/SDL_ttf.h"
+
+// Glyph atlas for HUD text.
+// Printable ASCII is rasterized once at startup into a single texture and
+// strings are drawn as one batch of textured quads. Other characters are added
+// the first time they are drawn; the texture is only uploaded again when
+// glyphs were added, and only recreated when the atlas has to grow.
+
+#define FONT_ATLAS_FIRST_CHAR 32
+#define FONT_ATLAS_CHAR_COUNT (256 - FONT_ATLAS_FIRST_CHAR)
+#define FONT_ATLAS_WIDTH 512
+#define FONT_ATLAS_BATCH_CHARS 64
+
+struct Font_Glyph
+{
+    SDL_Rect rect;
+    int advance;
+    bool loaded;
+};
+
+struct Font_Atlas
+{
+    TTF_Font *font;
+    SDL_Renderer *renderer;
+
+    SDL_Surface *surface;
+    SDL_Texture *texture;
+    bool dirty;
+
+    int pen_x;
+    int pen_y;
+    int row_height;
+
+    struct Font_Glyph glyphs[FONT_ATLAS_CHAR_COUNT];
+
+    int upload_count;
+
+    // Number of SDL_RenderGeometry calls since the caller last reset it
+    int draw_call_count;
+};
+
+static SDL_Surface *font_atlas_create_surface(int width, int height)
+{
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (surface)
+    {
+        SDL_FillRect(surface, 0, 0);
+        SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    }
+    return surface;
+}
+
+// Function to rasterize one character into the atlas surface
+// - atlas: atlas to add the glyph to
+// - ch: character to add
+// - returns false if the font has no such glyph or memory ran out
+static bool font_atlas_add_glyph(struct Font_Atlas *atlas, unsigned char ch)
+{
+    struct Font_Glyph *glyph = atlas->glyphs + (ch - FONT_ATLAS_FIRST_CHAR);
+
+    int advance = 0;
+    if (TTF_GlyphMetrics32(atlas->font, ch, 0, 0, 0, 0, &advance) < 0)
+    {
+        return false;
+    }
+
+    SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+    SDL_Surface *glyph_surface = TTF_RenderGlyph32_Blended(atlas->font, ch, white);
+    if (!glyph_surface)
+    {
+        // Blank glyphs such as space still need their advance
+        memset(&glyph->rect, 0, sizeof(glyph->rect));
+        glyph->advance = advance;
+        glyph->loaded = true;
+        return true;
+    }
+    SDL_SetSurfaceBlendMode(glyph_surface, SDL_BLENDMODE_NONE);
+
+    if (atlas->pen_x + glyph_surface->w > atlas->surface->w)
+    {
+        atlas->pen_x = 0;
+        atlas->pen_y += atlas->row_height;
+        atlas->row_height = 0;
+    }
+
+    // Double the atlas height when the glyph does not fit anymore
+    if (atlas->pen_y + glyph_surface->h > atlas->surface->h)
+    {
+        SDL_Surface *grown = font_atlas_create_surface(atlas->surface->w, atlas->surface->h * 2);
+        if (!grown)
+        {
+            SDL_FreeSurface(glyph_surface);
+            return false;
+        }
+        SDL_BlitSurface(atlas->surface, 0, grown, 0);
+        SDL_FreeSurface(atlas->surface);
+        atlas->surface = grown;
+
+        SDL_DestroyTexture(atlas->texture);
+        atlas->texture = 0;
+    }
+
+    glyph->rect.x = atlas->pen_x;
+    glyph->rect.y = atlas->pen_y;
+    glyph->rect.w = glyph_surface->w;
+    glyph->rect.h = glyph_surface->h;
+    glyph->advance = advance;
+    glyph->loaded = true;
+    SDL_BlitSurface(glyph_surface, 0, atlas->surface, &glyph->rect);
+
+    atlas->pen_x += glyph_surface->w + 1;
+    if (glyph_surface->h + 1 > atlas->row_height)
+    {
+        atlas->row_height = glyph_surface->h + 1;
+    }
+    atlas->dirty = true;
+
+    SDL_FreeSurface(glyph_surface);
+    return true;
+}
+
+// Function to upload the atlas surface if glyphs were added since the last upload
+static bool font_atlas_upload(struct Font_Atlas *atlas)
+{
+    if (!atlas->dirty)
+    {
+        return true;
+    }
+
+    if (!atlas->texture)
+    {
+        atlas->texture = SDL_CreateTexture(atlas->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, atlas->surface->w, atlas->surface->h);
+        if (!atlas->texture)
+        {
+            return false;
+        }
+        SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+    }
+
+    SDL_UpdateTexture(atlas->texture, 0, atlas->surface->pixels, atlas->surface->pitch);
+    atlas->dirty = false;
+    ++atlas->upload_count;
+    return true;
+}
+
+// Function to build the atlas for a font
+// - atlas: atlas to initialize
+// - renderer: SDL renderer the atlas texture belongs to
+// - font: TTF font to rasterize, it must stay open while the atlas is in use
+// - returns false if the atlas surface or texture could not be created
+static bool font_atlas_init(struct Font_Atlas *atlas, SDL_Renderer *renderer, TTF_Font *font)
+{
+    memset(atlas, 0, sizeof(*atlas));
+    atlas->font = font;
+    atlas->renderer = renderer;
+    atlas->surface = font_atlas_create_surface(FONT_ATLAS_WIDTH, 64);
+    if (!atlas->surface)
+    {
+        return false;
+    }
+
+    for (int ch = FONT_ATLAS_FIRST_CHAR; ch < 127; ++ch)
+    {
+        font_atlas_add_glyph(atlas, (unsigned char)ch);
+    }
+    return font_atlas_upload(atlas);
+}
+
+static void font_atlas_free(struct Font_Atlas *atlas)
+{
+    SDL_DestroyTexture(atlas->texture);
+    SDL_FreeSurface(atlas->surface);
+    memset(atlas, 0, sizeof(*atlas));
+}
+
+static const struct Font_Glyph *font_atlas_get_glyph(struct Font_Atlas *atlas, unsigned char ch)
+{
+    if (ch < FONT_ATLAS_FIRST_CHAR)
+    {
+        return 0;
+    }
+
+    struct Font_Glyph *glyph = atlas->glyphs + (ch - FONT_ATLAS_FIRST_CHAR);
+    if (!glyph->loaded && !font_atlas_add_glyph(atlas, ch))
+    {
+        return 0;
+    }
+    return glyph;
+}
+
+// Function to measure the width of a string in pixels
+static int font_atlas_measure(struct Font_Atlas *atlas, const char *text)
+{
+    int width = 0;
+    unsigned char previous = 0;
+    for (const unsigned char *c = (const unsigned char *)text; *c; ++c)
+    {
+        const struct Font_Glyph *glyph = font_atlas_get_glyph(atlas, *c);
+        if (!glyph)
+        {
+            continue;
+        }
+        if (previous)
+        {
+            width += TTF_GetFontKerningSizeGlyphs32(atlas->font, previous, *c);
+        }
+        width += glyph->advance;
+        previous = *c;
+    }
+    return width;
+}
+
+// Function to draw a string as textured quads from the atlas
+// - atlas: atlas holding the glyphs
+// - text: string to draw
+// - x, y: top-left corner of the string
+// - color: color the white glyphs are modulated with
+static void font_atlas_draw(struct Font_Atlas *atlas, const char *text, int x, int y, SDL_Color color)
+{
+    SDL_Vertex vertices[FONT_ATLAS_BATCH_CHARS * 4];
+    int indices[FONT_ATLAS_BATCH_CHARS * 6];
+    int quad_count = 0;
+
+    // Resolve every glyph before drawing so the texture is up to date
+    font_atlas_measure(atlas, text);
+    if (!font_atlas_upload(atlas))
+    {
+        return;
+    }
+
+    float inverse_width = 1.0f / atlas->surface->w;
+    float inverse_height = 1.0f / atlas->surface->h;
+
+    int pen_x = x;
+    unsigned char previous = 0;
+    for (const unsigned char *c = (const unsigned char *)text; *c; ++c)
+    {
+        const struct Font_Glyph *glyph = font_atlas_get_glyph(atlas, *c);
+        if (!glyph)
+        {
+            continue;
+        }
+        if (previous)
+        {
+            pen_x += TTF_GetFontKerningSizeGlyphs32(atlas->font, previous, *c);
+        }
+        previous = *c;
+
+        if (glyph->rect.w == 0)
+        {
+            pen_x += glyph->advance;
+            continue;
+        }
+
+        float x0 = (float)pen_x;
+        float y0 = (float)y;
+        float x1 = x0 + glyph->rect.w;
+        float y1 = y0 + glyph->rect.h;
+        float u0 = glyph->rect.x * inverse_width;
+        float v0 = glyph->rect.y * inverse_height;
+        float u1 = (glyph->rect.x + glyph->rect.w) * inverse_width;
+        float v1 = (glyph->rect.y + glyph->rect.h) * inverse_height;
+        pen_x += glyph->advance;
+
+        SDL_Vertex *quad = vertices + quad_count * 4;
+        quad[0] = (SDL_Vertex){{x0, y0}, color, {u0, v0}};
+        quad[1] = (SDL_Vertex){{x1, y0}, color, {u1, v0}};
+        quad[2] = (SDL_Vertex){{x1, y1}, color, {u1, v1}};
+        quad[3] = (SDL_Vertex){{x0, y1}, color, {u0, v1}};
+
+        int *quad_indices = indices + quad_count * 6;
+        int base = quad_count * 4;
+        quad_indices[0] = base;
+        quad_indices[1] = base + 1;
+        quad_indices[2] = base + 2;
+        quad_indices[3] = base;
+        quad_indices[4] = base + 2;
+        quad_indices[5] = base + 3;
+
+        if (++quad_count == FONT_ATLAS_BATCH_CHARS)
+        {
+            SDL_RenderGeometry(atlas->renderer, atlas->texture, vertices, quad_count * 4, indices, quad_count * 6);
+            ++atlas->draw_call_count;
+            quad_count = 0;
+        }
+    }
+
+    if (quad_count > 0)
+    {
+        SDL_RenderGeometry(atlas->renderer, atlas->texture, vertices, quad_count * 4, indices, quad_count * 6);
+        ++atlas->draw_call_count;
+    }
+}
+
+#endif
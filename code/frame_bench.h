@@ -0,0 +1,316 @@
+#ifndef FRAME_BENCH_H
+#define FRAME_BENCH_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "include/SDL2/SDL.h"
+
+#include "perf_hud.h"
+
+// Scripted benchmark of the real frame loop.
+// The main loop runs as usual, but key events come from an input script and
+// the game clock advances exactly one 60 Hz frame per loop iteration, so every
+// run plays the same game however fast frames are drawn. Per-phase costs come
+// from the perf HUD marks and are summed over the whole run; the summary is
+// checked against a thresholds file to catch regressions on CI.
+//
+// An input script has one event per line, "<frame> press|release <key>", with
+// keys named after the INPUT_KEY bits in order: left, right, rotate, down,
+// drop. "loop <frames>" repeats the script with that period. "--record-input"
+// writes the same format while playing, so real sessions can be replayed.
+//
+// A thresholds file has lines "<scenario> <phase> <max ms>": the mean cost of
+// the phase (INPUT, UPDATE, RENDER, PRESENT or FRAME) over the run must stay
+// under the limit. Lines for other scenarios are ignored.
+
+#define FRAME_BENCH_MAX_SCRIPT_EVENTS 4096
+#define FRAME_BENCH_KEY_COUNT 5
+
+enum Frame_Bench_Scenario
+{
+    FRAME_BENCH_SCENARIO_EMPTY,
+    FRAME_BENCH_SCENARIO_STACK,
+    FRAME_BENCH_SCENARIO_CLEARS,
+    FRAME_BENCH_SCENARIO_KILL_SCREEN,
+
+    FRAME_BENCH_SCENARIO_COUNT
+};
+
+static const char *FRAME_BENCH_SCENARIO_NAMES[FRAME_BENCH_SCENARIO_COUNT] = {"empty", "stack", "clears", "kill-screen"};
+
+static const char *FRAME_BENCH_KEY_NAMES[FRAME_BENCH_KEY_COUNT] = {"left", "right", "rotate", "down", "drop"};
+
+// Default scripts: wander and hard drop, the clears scenario only hard drops
+// so every piece lands where its rows were filled for it
+static const char *FRAME_BENCH_DEFAULT_SCRIPT =
+    "loop 48\n"
+    "4 press left\n6 release left\n"
+    "12 press rotate\n14 release rotate\n"
+    "20 press right\n22 release right\n"
+    "28 press right\n30 release right\n"
+    "40 press drop\n42 release drop\n";
+static const char *FRAME_BENCH_CLEARS_SCRIPT =
+    "loop 48\n"
+    "40 press drop\n42 release drop\n";
+
+struct Frame_Bench_Event
+{
+    int frame;
+
+    // Index into FRAME_BENCH_KEY_NAMES, the INPUT_KEY bit is 1 << key
+    int key;
+    bool pressed;
+};
+
+struct Frame_Bench
+{
+    enum Frame_Bench_Scenario scenario;
+    int frame_count;
+
+    struct Frame_Bench_Event events[FRAME_BENCH_MAX_SCRIPT_EVENTS];
+    int event_count;
+    int loop_frames;
+
+    // Set up again after each game over
+    int restart_count;
+
+    int frames_done;
+    Uint64 start;
+    double phase_total_ms[PERF_PHASE_COUNT];
+    float phase_max_ms[PERF_PHASE_COUNT];
+};
+
+// Function to look up a scenario by name
+// - returns false if there is no such scenario
+static bool frame_bench_find_scenario(const char *name, enum Frame_Bench_Scenario *scenario)
+{
+    for (int i = 0; i < FRAME_BENCH_SCENARIO_COUNT; ++i)
+    {
+        if (strcmp(name, FRAME_BENCH_SCENARIO_NAMES[i]) == 0)
+        {
+            *scenario = (enum Frame_Bench_Scenario)i;
+            return true;
+        }
+    }
+    printf("Unknown benchmark scenario: %s\n", name);
+    return false;
+}
+
+// Function to parse an input script
+// - bench: benchmark the events are added to
+// - text: the whole script
+// - name: name of the script for error messages
+// - returns false on a malformed line
+static bool frame_bench_parse_script(struct Frame_Bench *bench, const char *text, const char *name)
+{
+    bench->event_count = 0;
+    bench->loop_frames = 0;
+
+    int line_number = 0;
+    while (*text)
+    {
+        ++line_number;
+        const char *end = strchr(text, '\n');
+        size_t length = end ? (size_t)(end - text) : strlen(text);
+
+        char line[256];
+        length = length < sizeof(line) - 1 ? length : sizeof(line) - 1;
+        memcpy(line, text, length);
+        line[length] = 0;
+        text += end ? (size_t)(end - text) + 1 : strlen(text);
+
+        int frame = 0;
+        char action[16];
+        char key_name[16];
+        if (sscanf(line, " loop %d", &bench->loop_frames) == 1)
+        {
+            continue;
+        }
+
+        int field_count = sscanf(line, " %d %15s %15s", &frame, action, key_name);
+        if (field_count <= 0)
+        {
+            continue;
+        }
+
+        int key = -1;
+        for (int i = 0; field_count == 3 && i < FRAME_BENCH_KEY_COUNT; ++i)
+        {
+            key = strcmp(key_name, FRAME_BENCH_KEY_NAMES[i]) == 0 ? i : key;
+        }
+        bool pressed = strcmp(action, "press") == 0;
+        if (key < 0 || frame < 0 || (!pressed && strcmp(action, "release") != 0) ||
+            bench->event_count == FRAME_BENCH_MAX_SCRIPT_EVENTS)
+        {
+            printf("%s:%d: invalid input script line\n", name, line_number);
+            return false;
+        }
+
+        struct Frame_Bench_Event *event = bench->events + bench->event_count++;
+        event->frame = frame;
+        event->key = key;
+        event->pressed = pressed;
+    }
+    return true;
+}
+
+// Function to load an input script file
+// - returns false if the file is missing or malformed
+static bool frame_bench_load_script(struct Frame_Bench *bench, const char *filename)
+{
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+    {
+        printf("Failed to open input script: %s\n", filename);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *text = size >= 0 ? (char *)malloc((size_t)size + 1) : 0;
+    bool valid = text && fread(text, 1, (size_t)size, file) == (size_t)size;
+    fclose(file);
+    if (valid)
+    {
+        text[size] = 0;
+        valid = frame_bench_parse_script(bench, text, filename);
+    }
+    free(text);
+    return valid;
+}
+
+// Function to set up a benchmark run
+// - bench: benchmark to initialize
+// - scenario: game situation to measure
+// - frame_count: frames to run
+// - script_filename: input script to play, or 0 for the scenario's default script
+// - returns false if the script could not be loaded
+static bool frame_bench_init(struct Frame_Bench *bench, enum Frame_Bench_Scenario scenario, int frame_count, const char *script_filename)
+{
+    memset(bench, 0, sizeof(*bench));
+    bench->scenario = scenario;
+    bench->frame_count = frame_count;
+    if (script_filename)
+    {
+        return frame_bench_load_script(bench, script_filename);
+    }
+
+    const char *script = scenario == FRAME_BENCH_SCENARIO_CLEARS ? FRAME_BENCH_CLEARS_SCRIPT : FRAME_BENCH_DEFAULT_SCRIPT;
+    return frame_bench_parse_script(bench, script, FRAME_BENCH_SCENARIO_NAMES[scenario]);
+}
+
+// Function to find the script events of a frame
+// - bench: the benchmark
+// - frame: frame number from the start of the run
+// - events: receives up to max_count events, in script order
+// - returns the number of events
+static int frame_bench_script_events(const struct Frame_Bench *bench, int frame, struct Frame_Bench_Event *events, int max_count)
+{
+    int script_frame = bench->loop_frames > 0 ? frame % bench->loop_frames : frame;
+    int count = 0;
+    for (int i = 0; i < bench->event_count && count < max_count; ++i)
+    {
+        if (bench->events[i].frame == script_frame)
+        {
+            events[count++] = bench->events[i];
+        }
+    }
+    return count;
+}
+
+// Function to add the phase costs of a finished frame
+// - bench: the benchmark
+// - hud: perf HUD right after perf_hud_end_frame
+// - returns true once every frame of the run is done
+static bool frame_bench_end_frame(struct Frame_Bench *bench, const struct Perf_Hud *hud)
+{
+    if (bench->frames_done == 0)
+    {
+        bench->start = SDL_GetPerformanceCounter();
+    }
+
+    for (int phase = 0; phase < PERF_PHASE_COUNT; ++phase)
+    {
+        float ms = hud->current_ms[phase];
+        bench->phase_total_ms[phase] += ms;
+        bench->phase_max_ms[phase] = ms > bench->phase_max_ms[phase] ? ms : bench->phase_max_ms[phase];
+    }
+    return ++bench->frames_done >= bench->frame_count;
+}
+
+// Function to print the results and check them against a thresholds file
+// - bench: the finished benchmark
+// - thresholds_filename: file of per-phase limits, or 0 to only print
+// - out: stream to print to
+// - returns false if a limit was exceeded or the thresholds file could not be read
+static bool frame_bench_report(const struct Frame_Bench *bench, const char *thresholds_filename, FILE *out)
+{
+    int frames = bench->frames_done > 0 ? bench->frames_done : 1;
+    double seconds = (double)(SDL_GetPerformanceCounter() - bench->start) / SDL_GetPerformanceFrequency();
+    const char *scenario_name = FRAME_BENCH_SCENARIO_NAMES[bench->scenario];
+
+    fprintf(out, "bench %s: %d frames, %.1f fps, %d restarts\n",
+            scenario_name, bench->frames_done, seconds > 0 ? bench->frames_done / seconds : 0.0, bench->restart_count);
+    for (int phase = 0; phase < PERF_PHASE_COUNT; ++phase)
+    {
+        fprintf(out, "  %-8s mean %7.3f ms  max %7.3f ms\n",
+                PERF_PHASE_NAMES[phase], bench->phase_total_ms[phase] / frames, bench->phase_max_ms[phase]);
+    }
+
+    if (!thresholds_filename)
+    {
+        return true;
+    }
+
+    FILE *file = fopen(thresholds_filename, "r");
+    if (!file)
+    {
+        printf("Failed to open thresholds: %s\n", thresholds_filename);
+        return false;
+    }
+
+    bool passed = true;
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        char scenario[32];
+        char phase_name[16];
+        double limit_ms = 0;
+        if (sscanf(line, " %31s %15s %lf", scenario, phase_name, &limit_ms) != 3 || scenario[0] == '#' ||
+            strcmp(scenario, scenario_name) != 0)
+        {
+            continue;
+        }
+
+        for (int phase = 0; phase < PERF_PHASE_COUNT; ++phase)
+        {
+            double mean_ms = bench->phase_total_ms[phase] / frames;
+            if (strcmp(phase_name, PERF_PHASE_NAMES[phase]) == 0 && mean_ms > limit_ms)
+            {
+                fprintf(out, "  %s mean %.3f ms is over the %.3f ms threshold\n", phase_name, mean_ms, limit_ms);
+                passed = false;
+            }
+        }
+    }
+    fclose(file);
+
+    fprintf(out, "bench %s: %s\n", scenario_name, passed ? "passed" : "FAILED");
+    return passed;
+}
+
+// Function to append a key event to a recorded input script
+// - file: script being recorded
+// - frame: 60 Hz frame number of the event from the start of the recording
+// - key: index into FRAME_BENCH_KEY_NAMES
+// - pressed: true for a press
+static void frame_bench_record_event(FILE *file, int frame, int key, bool pressed)
+{
+    fprintf(file, "%d %s %s\n", frame, pressed ? "press" : "release", FRAME_BENCH_KEY_NAMES[key]);
+}
+
+#endif
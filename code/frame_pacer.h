@@ -0,0 +1,232 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "include/SDL2/SDL.h"
+
+// Frame limiter for when vsync does not hold the loop back.
+// After each present the pacer measures how long the frame took on its own.
+// If that is already close to the target interval, vsync (or a slow frame) is
+// pacing the loop and the pacer does nothing. Otherwise it sleeps until shortly
+// before the deadline and spins for the last stretch, which keeps jitter low
+// without burning a core. Frame intervals are kept for percentile reports.
+//
+// With late latching the pacer instead waits before the frame: it predicts the
+// next vsync from the last present and the refresh period, and sleeps until
+// the input poll, update and render are just expected to finish in time. The
+// age of the polled input at the end of the present is kept for reports in
+// both modes, so the two can be compared.
+
+#define FRAME_PACER_HISTORY_COUNT 1024
+#define FRAME_PACER_SPIN_SECONDS 0.002
+
+// Headroom kept between the expected end of the frame work and the vsync
+#define FRAME_PACER_LATCH_MARGIN_SECONDS 0.002
+
+// Per frame decay of the frame work peak, a slow frame is remembered for about a second
+#define FRAME_PACER_WORK_PEAK_DECAY 0.98
+
+struct Frame_Pacer
+{
+    Uint64 frequency;
+    Uint64 target_ticks;
+
+    Uint64 frame_start;
+    Uint64 last_present;
+    Uint64 next_deadline;
+
+    // Smoothed frame time without the pacer's own waiting, in ticks
+    double work_ticks;
+    bool limiting;
+
+    float intervals_ms[FRAME_PACER_HISTORY_COUNT];
+    int interval_count;
+    int interval_head;
+
+    // Late latching, the refresh period is in ticks
+    bool late_latch;
+    Uint64 refresh_ticks;
+    bool present_phase_known;
+    Uint64 latch_time;
+    double work_peak_ticks;
+
+    // Time from the input poll to the end of the present
+    float latencies_ms[FRAME_PACER_HISTORY_COUNT];
+    int latency_count;
+    int latency_head;
+};
+
+// Function to wait until a performance counter deadline
+// Sleeps while the deadline is far away and spins for the last FRAME_PACER_SPIN_SECONDS.
+// - deadline: performance counter value to wait for
+// - returns the performance counter after waiting
+static Uint64 frame_pacer_wait_until(Uint64 deadline)
+{
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 spin_ticks = (Uint64)(FRAME_PACER_SPIN_SECONDS * frequency);
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (now + spin_ticks < deadline)
+    {
+        Uint64 sleep_ticks = deadline - now - spin_ticks;
+        SDL_Delay((Uint32)(sleep_ticks * 1000 / frequency));
+    }
+    while ((now = SDL_GetPerformanceCounter()) < deadline)
+    {
+    }
+    return now;
+}
+
+// Function to set up the pacer
+// - pacer: pacer to initialize
+// - target_fps: frames per second to hold, 0 disables the limiter
+static void frame_pacer_init(struct Frame_Pacer *pacer, int target_fps)
+{
+    memset(pacer, 0, sizeof(*pacer));
+    pacer->frequency = SDL_GetPerformanceFrequency();
+    pacer->target_ticks = target_fps > 0 ? pacer->frequency / target_fps : 0;
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    pacer->frame_start = now;
+    pacer->last_present = now;
+    pacer->next_deadline = now + pacer->target_ticks;
+    pacer->latch_time = now;
+}
+
+// Function to switch to late latching
+// - pacer: the pacer
+// - refresh_rate: display refresh rate in Hz, 0 if unknown to use the target frame rate
+static void frame_pacer_enable_late_latch(struct Frame_Pacer *pacer, int refresh_rate)
+{
+    pacer->late_latch = true;
+    pacer->refresh_ticks = refresh_rate > 0 ? pacer->frequency / refresh_rate : pacer->target_ticks;
+}
+
+// Function to call right before polling input
+// With late latching this waits until the frame has just enough time left before the next vsync.
+static void frame_pacer_latch(struct Frame_Pacer *pacer)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (pacer->late_latch && pacer->present_phase_known && pacer->refresh_ticks > 0)
+    {
+        // First vsync after the last present that the frame work can still make
+        Uint64 lead = (Uint64)(pacer->work_peak_ticks + FRAME_PACER_LATCH_MARGIN_SECONDS * pacer->frequency);
+        Uint64 vsync = pacer->last_present + pacer->refresh_ticks;
+        if (vsync < now + lead)
+        {
+            vsync += (now + lead - vsync + pacer->refresh_ticks - 1) / pacer->refresh_ticks * pacer->refresh_ticks;
+        }
+        now = frame_pacer_wait_until(vsync - lead);
+    }
+
+    pacer->latch_time = now;
+    pacer->frame_start = now;
+}
+
+// Function to call right before SDL_RenderPresent
+// Measures the frame work that late latching has to leave time for.
+static void frame_pacer_submit(struct Frame_Pacer *pacer)
+{
+    double work = (double)(SDL_GetPerformanceCounter() - pacer->latch_time);
+    double decayed = pacer->work_peak_ticks * FRAME_PACER_WORK_PEAK_DECAY;
+    pacer->work_peak_ticks = work > decayed ? work : decayed;
+}
+
+// Function to call right after SDL_RenderPresent
+// Records the frame interval and waits for the next frame deadline when needed.
+static void frame_pacer_end_frame(struct Frame_Pacer *pacer)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    double work = (double)(now - pacer->frame_start);
+    pacer->work_ticks = pacer->work_ticks > 0 ? pacer->work_ticks * 0.9 + work * 0.1 : work;
+    pacer->limiting = !pacer->late_latch && pacer->target_ticks > 0 && pacer->work_ticks < pacer->target_ticks * 0.9;
+
+    pacer->latencies_ms[pacer->latency_head] = (float)((double)(now - pacer->latch_time) * 1000.0 / pacer->frequency);
+    pacer->latency_head = (pacer->latency_head + 1) % FRAME_PACER_HISTORY_COUNT;
+    if (pacer->latency_count < FRAME_PACER_HISTORY_COUNT)
+    {
+        ++pacer->latency_count;
+    }
+
+    if (pacer->limiting)
+    {
+        // Start over from now after a long stall instead of rushing to catch up
+        if (now > pacer->next_deadline + pacer->target_ticks)
+        {
+            pacer->next_deadline = now;
+        }
+
+        now = frame_pacer_wait_until(pacer->next_deadline);
+        pacer->next_deadline += pacer->target_ticks;
+    }
+    else
+    {
+        pacer->next_deadline = now + pacer->target_ticks;
+    }
+
+    pacer->intervals_ms[pacer->interval_head] = (float)((double)(now - pacer->last_present) * 1000.0 / pacer->frequency);
+    pacer->interval_head = (pacer->interval_head + 1) % FRAME_PACER_HISTORY_COUNT;
+    if (pacer->interval_count < FRAME_PACER_HISTORY_COUNT)
+    {
+        ++pacer->interval_count;
+    }
+
+    pacer->last_present = now;
+    pacer->frame_start = now;
+    pacer->present_phase_known = true;
+}
+
+// Function to restart timing after the loop was blocked on purpose
+// The blocked time is neither paced nor recorded as a frame interval.
+static void frame_pacer_resume(struct Frame_Pacer *pacer)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    pacer->frame_start = now;
+    pacer->last_present = now;
+    pacer->next_deadline = now + pacer->target_ticks;
+    pacer->present_phase_known = false;
+}
+
+static int frame_pacer_compare_float(const void *a, const void *b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+// Function to print percentiles of a recorded history
+static void frame_pacer_report_history(const float *history, int count, const char *name, const char *mode, FILE *out)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    float sorted[FRAME_PACER_HISTORY_COUNT];
+    memcpy(sorted, history, sizeof(float) * count);
+    qsort(sorted, count, sizeof(float), frame_pacer_compare_float);
+
+    fprintf(out, "%s over %d frames: p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms (%s)\n",
+            name,
+            count,
+            sorted[count * 50 / 100],
+            sorted[count * 90 / 100],
+            sorted[count * 99 / 100],
+            sorted[count - 1],
+            mode);
+}
+
+// Function to print frame interval and input age percentiles over the recorded history
+static void frame_pacer_report(const struct Frame_Pacer *pacer, FILE *out)
+{
+    const char *mode = pacer->late_latch ? "late latch" : (pacer->target_ticks == 0 ? "unlimited" : (pacer->limiting ? "limiter" : "vsync"));
+    frame_pacer_report_history(pacer->intervals_ms, pacer->interval_count, "frame time", mode, out);
+    frame_pacer_report_history(pacer->latencies_ms, pacer->latency_count, "input age at present", mode, out);
+}
+
+#endif
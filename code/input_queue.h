@@ -0,0 +1,83 @@
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "include/SDL2/SDL.h"
+
+// Lock-free queue of timestamped key events for one producer and one consumer.
+// The main thread pushes key presses and releases as SDL reports them; the
+// thread running the simulation pops them in order and applies each one at its
+// own timestamp, so presses shorter than a frame are never lost. Events are
+// dropped when the queue is full.
+
+#define INPUT_QUEUE_CAPACITY 256
+
+struct Input_Event
+{
+    // SDL_GetTicks time the key changed, in milliseconds
+    Uint32 timestamp;
+
+    // INPUT_KEY bit of the key
+    int key;
+    bool pressed;
+
+    // Performance counter when the main loop polled the event, for latency measurement
+    Uint64 polled_at;
+};
+
+struct Input_Queue
+{
+    struct Input_Event events[INPUT_QUEUE_CAPACITY];
+
+    // Only written by the consumer
+    SDL_atomic_t head;
+
+    // Only written by the producer
+    SDL_atomic_t tail;
+};
+
+static void input_queue_init(struct Input_Queue *queue)
+{
+    memset(queue, 0, sizeof(*queue));
+}
+
+// Function to append an event, called by the producer
+// - returns false if the queue is full
+static bool input_queue_push(struct Input_Queue *queue, const struct Input_Event *event)
+{
+    int tail = SDL_AtomicGet(&queue->tail);
+    if (tail - SDL_AtomicGet(&queue->head) == INPUT_QUEUE_CAPACITY)
+    {
+        return false;
+    }
+
+    queue->events[tail % INPUT_QUEUE_CAPACITY] = *event;
+
+    // SDL_AtomicSet is a full barrier, the event is visible before the new tail
+    SDL_AtomicSet(&queue->tail, tail + 1);
+    return true;
+}
+
+// Function to look at the oldest event without removing it, called by the consumer
+// - returns false if the queue is empty
+static bool input_queue_peek(struct Input_Queue *queue, struct Input_Event *event)
+{
+    int head = SDL_AtomicGet(&queue->head);
+    if (head == SDL_AtomicGet(&queue->tail))
+    {
+        return false;
+    }
+
+    *event = queue->events[head % INPUT_QUEUE_CAPACITY];
+    return true;
+}
+
+// Function to remove the oldest event, called by the consumer after input_queue_peek
+static void input_queue_pop(struct Input_Queue *queue)
+{
+    SDL_AtomicSet(&queue->head, SDL_AtomicGet(&queue->head) + 1);
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "include/SDL2/SDL.h"
+
+// Input-to-display latency measurement.
+// Every key event is stamped with the performance counter when the main loop
+// polls it. The engine keeps the stamp of the oldest event that changed the
+// game and has not been shown yet; once a frame showing that state has been
+// presented, the time from the stamp to the end of SDL_RenderPresent is one
+// sample. Samples are summarized on exit and appended as one CSV row to a
+// report file, labelled with the build and the renderer backend, so rows from
+// different builds and machines can be compared side by side.
+
+#define LATENCY_PROBE_SAMPLE_COUNT 4096
+
+struct Latency_Probe
+{
+    Uint64 frequency;
+
+    // Stamp of the last recorded sample, a state shown twice is only counted once
+    Uint64 last_stamp;
+
+    float samples_ms[LATENCY_PROBE_SAMPLE_COUNT];
+    int sample_count;
+    int sample_head;
+
+    // CSV file the summary is appended to, 0 when not measuring
+    const char *report_filename;
+};
+
+// Function to set up the probe
+// - probe: probe to initialize
+// - report_filename: CSV file to append the summary to, 0 disables measuring
+static void latency_probe_init(struct Latency_Probe *probe, const char *report_filename)
+{
+    memset(probe, 0, sizeof(*probe));
+    probe->frequency = SDL_GetPerformanceFrequency();
+    probe->report_filename = report_filename;
+}
+
+// Function to record a sample after a frame has been presented
+// - probe: the probe
+// - stamp: performance counter of the oldest input the frame shows the effect of, 0 for none
+// - presented: performance counter after SDL_RenderPresent returned
+static void latency_probe_record(struct Latency_Probe *probe, Uint64 stamp, Uint64 presented)
+{
+    if (!probe->report_filename || stamp == 0 || stamp == probe->last_stamp || stamp > presented)
+    {
+        return;
+    }
+    probe->last_stamp = stamp;
+
+    probe->samples_ms[probe->sample_head] = (float)((double)(presented - stamp) * 1000.0 / probe->frequency);
+    probe->sample_head = (probe->sample_head + 1) % LATENCY_PROBE_SAMPLE_COUNT;
+    if (probe->sample_count < LATENCY_PROBE_SAMPLE_COUNT)
+    {
+        ++probe->sample_count;
+    }
+}
+
+static int latency_probe_compare_float(const void *a, const void *b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+// Function to name the compile-time options that change frame timing
+static const char *latency_probe_build_name(void)
+{
+#if defined(TRACING) && defined(ALLOC_TRACKING)
+    return "tracing+alloc-tracking";
+#elif defined(TRACING)
+    return "tracing";
+#elif defined(ALLOC_TRACKING)
+    return "alloc-tracking";
+#else
+    return "release";
+#endif
+}
+
+// Function to print the latency distribution and append it to the report file
+// - probe: the probe
+// - mode: runtime options of the run, e.g. "sim-thread"
+// - backend: renderer backend, e.g. "raster/opengl"
+// - out: stream to print the summary to
+// - returns false if the report file could not be written
+static bool latency_probe_report(const struct Latency_Probe *probe, const char *mode, const char *backend, FILE *out)
+{
+    if (!probe->report_filename)
+    {
+        return true;
+    }
+
+    int count = probe->sample_count;
+    float *sorted = (float *)malloc(sizeof(float) * (count > 0 ? count : 1));
+    if (!sorted)
+    {
+        return false;
+    }
+    memcpy(sorted, probe->samples_ms, sizeof(float) * count);
+    qsort(sorted, count, sizeof(float), latency_probe_compare_float);
+
+    float p50 = count > 0 ? sorted[count * 50 / 100] : 0;
+    float p90 = count > 0 ? sorted[count * 90 / 100] : 0;
+    float p99 = count > 0 ? sorted[count * 99 / 100] : 0;
+    float max = count > 0 ? sorted[count - 1] : 0;
+    free(sorted);
+
+    fprintf(out, "input latency over %d inputs: p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms (%s, %s, %s)\n",
+            count, p50, p90, p99, max, latency_probe_build_name(), mode, backend);
+
+    // A header is written when the file is new, later runs only add rows
+    FILE *file = fopen(probe->report_filename, "a");
+    if (!file)
+    {
+        printf("Failed to open %s\n", probe->report_filename);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0)
+    {
+        fprintf(file, "build,mode,backend,samples,p50_ms,p90_ms,p99_ms,max_ms\n");
+    }
+    fprintf(file, "%s,%s,%s,%d,%.3f,%.3f,%.3f,%.3f\n",
+            latency_probe_build_name(), mode, backend, count, p50, p90, p99, max);
+    fclose(file);
+    return true;
+}
+
+#endif
@@ -3,65 +3,82 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 #include <assert.h>
 
 #include "include/SDL2/SDL.h"
 #include "include/SDL2/SDL_ttf.h"
 #include "include/SDL2/SDL_mixer.h"
 
-#define WIDTH 10
-#define HEIGHT 22
-#define VISIBLE_HEIGHT 20
+#include "alloc_tracker.h"
+#include "arena.h"
+#include "board.h"
+#include "ruleset.h"
+#include "random.h"
+#include "font_atlas.h"
+#include "render_commands.h"
+#include "raster.h"
+#include "frame_pacer.h"
+#include "triple_buffer.h"
+#include "input_queue.h"
+#include "latency_probe.h"
+#include "frame_bench.h"
+#include "board_corpus.h"
+#include "terminal.h"
+#include "perf_hud.h"
+#include "trace.h"
+#include "audio.h"
+#include "asset_pack.h"
+#include "score_store.h"
+
+#ifdef ASSET_PACK_EMBEDDED
+#include "assets_pack_data.h"
+#endif
+
 #define GRID_SIZE 30
+#define PIECE_PREVIEW_COUNT 5
+#define IDLE_WAIT_MS 1000
+#define STARTUP_BUDGET_MS 100
+#define ASSET_PACK_FILENAME "assets.pack"
+
+// Engine microbenchmarks take the fastest of several samples of at least this length
+#define ENGINE_BENCHMARK_SAMPLE_MS 50
+#define ENGINE_BENCHMARK_SAMPLE_COUNT 7
+#define BOARD_CORPUS_BOARDS_PER_CATEGORY 32
+
+// Terminal frontend layout, taller boards scroll with the falling piece
+#define TERMINAL_MAX_BOARD_ROWS 40
+#define TERMINAL_PANEL_COLUMNS 16
+#define TERMINAL_STATUS_COLUMNS 48
 
 #define ARRAY_COUNT(x) (sizeof(x) / sizeof((x)[0]))
 #define ZERO_STRUCT(obj) memset(&(obj), 0, sizeof(obj))
 
-// Function to load a sound effect from a file
-// - takes filename
+// Function to load a sound effect
+// - takes the asset pack and the name of the sound in it
 // - returns pointer to the loaded sound effect
-Mix_Chunk *loadSound(const char *filename)
+Mix_Chunk *loadSound(const struct Asset_Pack *pack, const char *name)
 {
-    Mix_Chunk *sound = Mix_LoadWAV(filename);
+    Mix_Chunk *sound = Mix_LoadWAV_RW(asset_pack_open_rw(pack, name), 1);
     if (!sound)
     {
         printf("Failed to load sound: %s\n", Mix_GetError());
     }
     return sound;
 }
-Mix_Chunk *clear_line_sound, *game_over_sound, *theme_sound;
-
-static const unsigned char FRAMES_PER_DROP[] = {
-    48,
-    43,
-    38,
-    33,
-    28,
-    23,
-    18,
-    13,
-    8,
-    6,
-    5,
-    5,
-    5,
-    4,
-    4,
-    4,
-    3,
-    3,
-    3,
-    2,
-    2,
-    2,
-    2,
-    2,
-    2,
-    2,
-    2,
-    2,
-    2,
-    1};
+
+// Function to open music, it is decoded while it plays
+// - takes the asset pack and the name of the music in it
+// - returns pointer to the opened music
+Mix_Music *loadMusic(const struct Asset_Pack *pack, const char *name)
+{
+    Mix_Music *music = Mix_LoadMUS_RW(asset_pack_open_rw(pack, name), 1);
+    if (!music)
+    {
+        printf("Failed to load music: %s\n", Mix_GetError());
+    }
+    return music;
+}
 
 static const float TARGET_SECONDS_PER_FRAME = 1.f / 60.f;
 
@@ -153,6 +170,8 @@ static const struct Tetrino TETRINOS[] = {
     {TETRINO_6, 3},
     {TETRINO_7, 3}};
 
+_Static_assert(ARRAY_COUNT(TETRINOS) == RANDOMIZER_PIECE_COUNT, "randomizer must deal every tetrino");
+
 enum Game_Phase
 {
     GAME_PHASE_START,
@@ -171,23 +190,42 @@ struct Piece_State
 
 struct Game_State
 {
-    unsigned char board[WIDTH * HEIGHT];
-    unsigned char lines[HEIGHT];
+    const struct Ruleset *rules;
+    struct Board board;
+    unsigned char lines[BOARD_MAX_HEIGHT];
     int pending_line_count;
 
     struct Piece_State piece;
 
+    // Upcoming pieces, next_pieces[next_piece_head] spawns next
+    struct Randomizer randomizer;
+    unsigned char next_pieces[PIECE_PREVIEW_COUNT];
+    int next_piece_head;
+
     enum Game_Phase phase;
     bool paused;
 
+    // AUDIO_EVENT bits raised since the frontend last played them
+    unsigned audio_events;
+    bool audio_paused;
+
+    // Every game deals its pieces from its own seed, derived from the session seed
+    uint64_t session_seed;
+    uint64_t game_seed;
+    int game_count;
+
     int start_level;
     int level;
     int line_count;
     int points;
 
-    float next_drop_time;
-    float highlight_end_time;
-    float time;
+    // Seconds since SDL started, a double so a frame still registers after days of uptime
+    double next_drop_time;
+    double highlight_end_time;
+    double time;
+
+    // Poll time of the oldest key event that changed the game and is not shown yet, 0 if none
+    Uint64 input_polled_at;
 };
 
 struct Input_State
@@ -204,6 +242,9 @@ struct Input_State
     char dup;
     char ddown;
     char da;
+
+    // Cells to shift the piece sideways, from presses and auto-repeat, negative is left
+    int shift;
 };
 
 enum Text_Align
@@ -213,18 +254,6 @@ enum Text_Align
     TEXT_ALIGN_RIGHT
 };
 
-static unsigned char matrix_get(const unsigned char *values, int width, int row, int col)
-{
-    int index = row * width + col;
-    return values[index];
-}
-
-static void matrix_set(unsigned char *values, int width, int row, int col, unsigned char value)
-{
-    int index = row * width + col;
-    values[index] = value;
-}
-
 static unsigned char tetrino_get(const struct Tetrino *tetrino, int row, int col, int rotation)
 {
     int side = tetrino->side;
@@ -242,69 +271,71 @@ static unsigned char tetrino_get(const struct Tetrino *tetrino, int row, int col
     return 0;
 }
 
-static unsigned char check_row_filled(const unsigned char *values, int width, int row)
+static int find_lines(const struct Board *board, unsigned char *lines_out)
 {
-    for (int col = 0; col < width; ++col)
-    {
-        if (!matrix_get(values, width, row, col))
-        {
-            return 0;
-        }
-    }
-    return 1;
-}
+    TRACE_SCOPE("find_lines");
+    TRACE_COUNT_N(TRACE_COUNTER_ROWS_SCANNED, board->height - board->stack_top);
 
-static unsigned char check_row_empty(const unsigned char *values, int width, int row)
-{
-    for (int col = 0; col < width; ++col)
-    {
-        if (matrix_get(values, width, row, col))
-        {
-            return 0;
-        }
-    }
-    return 1;
-}
+    // Rows above the stack are empty and cannot be filled
+    memset(lines_out, 0, board->stack_top);
 
-static int find_lines(const unsigned char *values, int width, int height, unsigned char *lines_out)
-{
     int count = 0;
-    for (int row = 0; row < height; ++row)
+    for (int row = board->stack_top; row < board->height; ++row)
     {
-        unsigned char filled = check_row_filled(values, width, row);
+        unsigned char filled = board_row_filled(board, row);
         lines_out[row] = filled;
         count += filled;
     }
     return count;
 }
 
-static void clear_lines(unsigned char *values, int width, int height, const unsigned char *lines)
+// Function to remove the filled rows and let the rows above fall down
+// - board: board to clear the lines from
+// - lines: one flag per row, as produced by find_lines
+// Only row indices from the stack top down to the lowest cleared row move,
+// the cleared rows are recycled as empty rows at the top of the stack.
+static void clear_lines(struct Board *board, const unsigned char *lines)
 {
-    int src_row = height - 1;
-    for (int dst_row = height - 1; dst_row >= 0; --dst_row)
+    TRACE_SCOPE("clear_lines");
+
+    uint16_t cleared_rows[BOARD_MAX_HEIGHT];
+    int cleared_count = 0;
+
+    int lowest_row = board->height - 1;
+    while (lowest_row >= board->stack_top && !lines[lowest_row])
     {
-        while (src_row >= 0 && lines[src_row])
-        {
-            --src_row;
-        }
+        --lowest_row;
+    }
 
-        if (src_row < 0)
+    int dst_row = lowest_row;
+    for (int src_row = lowest_row; src_row >= board->stack_top; --src_row)
+    {
+        if (lines[src_row])
         {
-            memset(values + dst_row * width, 0, width);
+            cleared_rows[cleared_count++] = board->rows[src_row];
         }
         else
         {
-            if (src_row != dst_row)
-            {
-                memcpy(values + dst_row * width, values + src_row * width, width);
-            }
-            --src_row;
+            board->rows[dst_row--] = board->rows[src_row];
         }
     }
+
+    for (int i = 0; i < cleared_count; ++i, --dst_row)
+    {
+        uint16_t physical_row = cleared_rows[i];
+        memset(board->cells + physical_row * BOARD_STRIDE, 0, BOARD_STRIDE);
+        board->masks[physical_row] = 0;
+        board->rows[dst_row] = physical_row;
+    }
+    board->stack_top += cleared_count;
+    ++board->revision;
 }
 
-static bool check_piece_valid(const struct Piece_State *piece, const unsigned char *board, int width, int height)
+static bool check_piece_valid(const struct Piece_State *piece, const struct Board *board)
 {
+    TRACE_SCOPE("check_piece_valid");
+    TRACE_COUNT(TRACE_COUNTER_COLLISION_TESTS);
+
     const struct Tetrino *tetrino = TETRINOS + piece->tetrino_index;
     assert(tetrino);
 
@@ -317,15 +348,15 @@ static bool check_piece_valid(const struct Piece_State *piece, const unsigned ch
             {
                 int board_row = piece->offset_row + row;
                 int board_col = piece->offset_col + col;
-                if (board_row < 0 || board_row >= height)
+                if (board_row < 0 || board_row >= board->height)
                 {
                     return false;
                 }
-                if (board_col < 0 || board_col >= width)
+                if (board_col < 0 || board_col >= board->width)
                 {
                     return false;
                 }
-                if (matrix_get(board, width, board_row, board_col))
+                if (board_get(board, board_row, board_col))
                 {
                     return false;
                 }
@@ -347,40 +378,71 @@ static void merge_piece(struct Game_State *game)
             {
                 int board_row = game->piece.offset_row + row;
                 int board_col = game->piece.offset_col + col;
-                matrix_set(game->board, WIDTH, board_row, board_col, value);
+                board_set(&game->board, board_row, board_col, value);
             }
         }
     }
 }
 
-static int random_int(int min, int max)
+// Gravity faster than one row per frame drops once per frame and moves several
+// rows each time, so drops are never scheduled closer together than a frame.
+// Intervals that small would vanish when added to the game clock.
+static float get_time_to_next_drop(const struct Ruleset *rules, int level)
 {
-    int range = max - min;
-    return min + rand() % range;
+    float frames = rules->frames_per_drop[ruleset_clamp_level(level)];
+    return (frames < 1.0f ? 1.0f : frames) * TARGET_SECONDS_PER_FRAME;
 }
 
-static float get_time_to_next_drop(int level)
+static int get_rows_per_drop(const struct Ruleset *rules, int level)
 {
-    if (level > 29)
+    float frames = rules->frames_per_drop[ruleset_clamp_level(level)];
+    return frames < 1.0f ? (int)(1.0f / frames + 0.5f) : 1;
+}
+
+// Function to reset the piece sequence of a game
+// - game: game state to reset
+// - mode: randomizer used to deal the pieces
+// - rng: generator the sequence is drawn from, copied into the game
+static void reset_piece_queue(struct Game_State *game, enum Randomizer_Mode mode, const struct Random *rng)
+{
+    randomizer_init(&game->randomizer, mode, rng);
+    for (int i = 0; i < PIECE_PREVIEW_COUNT; ++i)
     {
-        level = 29;
+        game->next_pieces[i] = randomizer_next(&game->randomizer);
     }
+    game->next_piece_head = 0;
+}
 
-    return FRAMES_PER_DROP[level] * TARGET_SECONDS_PER_FRAME;
+static unsigned char peek_next_piece(const struct Game_State *game, int index)
+{
+    return game->next_pieces[(game->next_piece_head + index) % PIECE_PREVIEW_COUNT];
+}
+
+static unsigned char pop_next_piece(struct Game_State *game)
+{
+    unsigned char tetrino_index = game->next_pieces[game->next_piece_head];
+    game->next_pieces[game->next_piece_head] = randomizer_next(&game->randomizer);
+    game->next_piece_head = (game->next_piece_head + 1) % PIECE_PREVIEW_COUNT;
+    return tetrino_index;
 }
 
 static void spawn_piece(struct Game_State *game)
 {
     ZERO_STRUCT(game->piece);
-    game->piece.tetrino_index = (unsigned char)random_int(0, ARRAY_COUNT(TETRINOS));
-    game->piece.offset_col = WIDTH / 2;
-    game->next_drop_time = game->time + get_time_to_next_drop(game->level);
+    game->piece.tetrino_index = pop_next_piece(game);
+    game->piece.offset_col = game->board.width / 2;
+    game->next_drop_time = game->time + get_time_to_next_drop(game->rules, game->level);
+}
+
+static void emit_audio_event(struct Game_State *game, enum Audio_Event event)
+{
+    game->audio_events |= 1u << event;
 }
 
 static bool soft_drop(struct Game_State *game)
 {
     ++game->piece.offset_row;
-    if (!check_piece_valid(&game->piece, game->board, WIDTH, HEIGHT))
+    if (!check_piece_valid(&game->piece, &game->board))
     {
         --game->piece.offset_row;
         merge_piece(game);
@@ -388,45 +450,32 @@ static bool soft_drop(struct Game_State *game)
         return false;
     }
 
-    game->next_drop_time = game->time + get_time_to_next_drop(game->level);
+    game->next_drop_time = game->time + get_time_to_next_drop(game->rules, game->level);
     return true;
 }
 
-static int compute_points(int level, int line_count)
+// Function to derive the seed of one game of a session
+// The first game uses the session seed itself, so "--seed" with a stored
+// replay id deals that game again; later games mix in their number.
+static uint64_t get_game_seed(uint64_t session_seed, int game_index)
 {
-    switch (line_count)
+    if (game_index == 0)
     {
-    case 1:
-        return 40 * (level + 1);
-    case 2:
-        return 100 * (level + 1);
-    case 3:
-        return 300 * (level + 1);
-    case 4:
-        return 1200 * (level + 1);
+        return session_seed;
     }
-    return 0;
+    uint64_t state = session_seed + (uint64_t)game_index * 0xD1B54A32D192ED03ull;
+    return random_splitmix(&state);
 }
 
-static int min(int x, int y)
-{
-    return x < y ? x : y;
-}
-static int max(int x, int y)
+static int compute_points(const struct Ruleset *rules, int level, int line_count)
 {
-    return x > y ? x : y;
+    return rules->points[line_count] * (level + 1);
 }
 
-static int get_lines_for_next_level(int start_level, int level)
+static int get_lines_for_next_level(const struct Ruleset *rules, int start_level, int level)
 {
-    int first_level_up_limit = min((start_level * 10 + 10), max(100, (start_level * 10 - 50)));
-    if (level == start_level)
-    {
-        return first_level_up_limit;
-    }
-
     int diff = level - start_level;
-    return first_level_up_limit + diff * 10;
+    return rules->first_level_lines[ruleset_clamp_level(start_level)] + diff * rules->lines_per_level;
 }
 
 // Function to update the game state during the start phase
@@ -435,7 +484,7 @@ static int get_lines_for_next_level(int start_level, int level)
 static void update_game_start(struct Game_State *game, const struct Input_State *input)
 {
     // Logic to handle input during the start phase
-    if (input->dup > 0)
+    if (input->dup > 0 && game->start_level < RULESET_LEVEL_COUNT - 1)
     {
         ++game->start_level;
     }
@@ -447,14 +496,20 @@ static void update_game_start(struct Game_State *game, const struct Input_State
 
     if (input->da > 0)
     {
-        memset(game->board, 0, WIDTH * HEIGHT);
+        // Without a fresh seed every game after the first would continue the
+        // previous game's sequence and could not be replayed on its own
+        struct Random rng;
+        game->game_seed = get_game_seed(game->session_seed, game->game_count++);
+        random_seed(&rng, game->game_seed);
+        reset_piece_queue(game, game->randomizer.mode, &rng);
+
+        board_clear(&game->board);
         game->level = game->start_level;
         game->line_count = 0;
         game->points = 0;
         spawn_piece(game);
         game->phase = GAME_PHASE_PLAY;
-        Mix_HaltChannel(-1);
-        Mix_PlayChannel(-1, theme_sound, -1);
+        emit_audio_event(game, AUDIO_EVENT_GAME_START);
     }
 }
 
@@ -477,11 +532,11 @@ static void update_game_line(struct Game_State *game)
     // Logic to line-clearing animation and its effects on the game state.
     if (game->time >= game->highlight_end_time)
     {
-        clear_lines(game->board, WIDTH, HEIGHT, game->lines);
+        clear_lines(&game->board, game->lines);
         game->line_count += game->pending_line_count;
-        game->points += compute_points(game->level, game->pending_line_count);
+        game->points += compute_points(game->rules, game->level, game->pending_line_count);
 
-        int lines_for_next_level = get_lines_for_next_level(game->start_level, game->level);
+        int lines_for_next_level = get_lines_for_next_level(game->rules, game->start_level, game->level);
         if (game->line_count >= lines_for_next_level)
         {
             ++game->level;
@@ -496,23 +551,29 @@ static void update_game_line(struct Game_State *game)
 // - input: Pointer to the input state structure
 static void update_game_play(struct Game_State *game, const struct Input_State *input)
 {
+    TRACE_SCOPE("update_game_play");
+
     // Logic to input during the play phase, such as moving pieces and checking for collisions.
     struct Piece_State piece = game->piece;
-    if (input->dleft > 0)
-    {
-        --piece.offset_col;
-    }
-    if (input->dright > 0)
-    {
-        ++piece.offset_col;
-    }
     if (input->dup > 0)
     {
         piece.rotation = (piece.rotation + 1) % 4;
+        if (check_piece_valid(&piece, &game->board))
+        {
+            game->piece = piece;
+        }
     }
 
-    if (check_piece_valid(&piece, game->board, WIDTH, HEIGHT))
+    // One cell at a time, a long auto-repeat shift stops at the first obstacle
+    int step = input->shift < 0 ? -1 : 1;
+    for (int i = 0; i != input->shift; i += step)
     {
+        piece = game->piece;
+        piece.offset_col += step;
+        if (!check_piece_valid(&piece, &game->board))
+        {
+            break;
+        }
         game->piece = piece;
     }
 
@@ -527,41 +588,54 @@ static void update_game_play(struct Game_State *game, const struct Input_State *
             ;
     }
 
+    // A piece that moved keeps falling up to the rows of one drop, it only locks
+    // on a drop that cannot move it at all
+    int rows_per_drop = get_rows_per_drop(game->rules, game->level);
     while (game->time >= game->next_drop_time)
     {
-        soft_drop(game);
+        for (int row = 0; row < rows_per_drop && soft_drop(game); ++row)
+        {
+            piece = game->piece;
+            ++piece.offset_row;
+            if (!check_piece_valid(&piece, &game->board))
+            {
+                break;
+            }
+        }
     }
 
-    game->pending_line_count = find_lines(game->board, WIDTH, HEIGHT, game->lines);
+    game->pending_line_count = find_lines(&game->board, game->lines);
     if (game->pending_line_count > 0)
     {
         game->phase = GAME_PHASE_LINE;
-        game->highlight_end_time = game->time + 0.5f;
+        game->highlight_end_time = game->time + 0.5;
+        emit_audio_event(game, AUDIO_EVENT_LINE_CLEAR);
     }
 
     int game_over_row = 0;
-    if (!check_row_empty(game->board, WIDTH, game_over_row))
+    if (!board_row_empty(&game->board, game_over_row))
     {
         game->phase = GAME_PHASE_GAMEOVER;
-        Mix_HaltChannel(-1);
-        Mix_PlayChannel(-1, game_over_sound, 0);
+        emit_audio_event(game, AUDIO_EVENT_GAME_OVER);
     }
 }
 
-// Function to resume playing the theme sound
-void resume_theme_sound()
-{
-    Mix_Resume(-1); // Resume all channels
-}
-
 // Function to update the game state based on user input
 // - game: pointer to the game state structure
 // - input: pointer to the input state structure
 static void update_game(struct Game_State *game, const struct Input_State *input)
 {
+    TRACE_SCOPE("update_game");
+
+    // Sound is paused and resumed once, on the update the pause state changes
+    if (game->paused != game->audio_paused)
+    {
+        emit_audio_event(game, game->paused ? AUDIO_EVENT_PAUSE : AUDIO_EVENT_RESUME);
+        game->audio_paused = game->paused;
+    }
+
     if (game->paused)
     {
-        Mix_Pause(-1); // Pause all channels
         return;
     }
 
@@ -581,86 +655,88 @@ static void update_game(struct Game_State *game, const struct Input_State *input
         update_game_gameover(game, input);
         break;
     }
+}
 
-    // Resume the theme sound
-    if (game->phase != GAME_PHASE_START && game->phase != GAME_PHASE_GAMEOVER)
-    {
-        resume_theme_sound();
-    }
+// Function to check whether the game shows a static screen
+// Nothing on the start, game over and pause screens changes without input.
+static bool is_game_idle(const struct Game_State *game)
+{
+    return game->paused || game->phase == GAME_PHASE_START || game->phase == GAME_PHASE_GAMEOVER;
 }
 
 // Function to fill a rectangular area with a specified color
-// - renderer: SDL renderer used for rendering graphics
+// - commands: frame command buffer the rectangle is recorded into
+// - layer: layer of the rectangle within the current pass
 // - x, y: Coordinates of the top-left corner of the rectangle
 // - width, height: Width and height of the rectangle
 // - color: Color to fill the rectangle with
-static void fill_rect(SDL_Renderer *renderer, int x, int y, int width, int height, struct Color color)
+static void fill_rect(struct Render_Commands *commands, enum Render_Layer layer, int x, int y, int width, int height, struct Color color)
 {
-    // SDL rendering functions to fill a rectangle with the specified color
+    // Recorded now, drawn in one batch per color by render_commands_submit
     SDL_Rect rect = {0};
     rect.x = x;
     rect.y = y;
     rect.w = width;
     rect.h = height;
-    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-    SDL_RenderFillRect(renderer, &rect);
+    SDL_Color sdl_color = {color.r, color.g, color.b, color.a};
+    render_commands_push(commands, layer, false, sdl_color, &rect);
 }
 
 // Function to draw a rectangular outline with a specified color
-// - renderer: SDL renderer used for rendering graphics
+// - commands: frame command buffer the rectangle is recorded into
+// - layer: layer of the rectangle within the current pass
 // - x, y: Coordinates of the top-left corner of the rectangle
 // - width, height: Width and height of the rectangle
 // - color: Color to draw the rectangle outline with
-static void draw_rect(SDL_Renderer *renderer, int x, int y, int width, int height, struct Color color)
+static void draw_rect(struct Render_Commands *commands, enum Render_Layer layer, int x, int y, int width, int height, struct Color color)
 {
-    // SDL rendering functions to draw the outline of a rectangle with the specified color
+    // Recorded now, drawn in one batch per color by render_commands_submit
     SDL_Rect rect = {0};
     rect.x = x;
     rect.y = y;
     rect.w = width;
     rect.h = height;
-    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-    SDL_RenderDrawRect(renderer, &rect);
+    SDL_Color sdl_color = {color.r, color.g, color.b, color.a};
+    render_commands_push(commands, layer, true, sdl_color, &rect);
 }
 
 // Function to draw a string of text on the screen
-// - renderer: SDL renderer used for rendering graphics
-// - font: TTF font used for rendering text
+// - atlas: glyph atlas of the font used for rendering text, 0 while the font is loading
 // - text: Text string to be rendered
 // - x, y: Coordinates of the top-left corner of the text
 // - alignment: Text alignment
 // - color: Color of the text
-static void draw_string(SDL_Renderer *renderer, TTF_Font *font, const char *text, int x, int y, enum Text_Align alignment, struct Color color)
+static void draw_string(struct Font_Atlas *atlas, const char *text, int x, int y, enum Text_Align alignment, struct Color color)
 {
-    // SDL_ttf functions to render text on the screen with the specified font, alignment, and color
-    SDL_Color sdl_color = {color.r, color.g, color.b, color.a};
-    SDL_Surface *surface = TTF_RenderText_Solid(font, text, sdl_color);
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+    TRACE_SCOPE("draw_string");
+    TRACE_COUNT_N(TRACE_COUNTER_GLYPHS_DRAWN, (int)strlen(text));
 
-    SDL_Rect rect;
-    rect.y = y;
-    rect.w = surface->w;
-    rect.h = surface->h;
+    // No text until the font has loaded
+    if (!atlas)
+    {
+        return;
+    }
+
+    // Glyphs come from the atlas texture, nothing is rasterized or uploaded here
+    SDL_Color sdl_color = {color.r, color.g, color.b, color.a};
+    int width = font_atlas_measure(atlas, text);
 
     switch (alignment)
     {
     case TEXT_ALIGN_LEFT:
-        rect.x = x;
         break;
     case TEXT_ALIGN_CENTER:
-        rect.x = x - surface->w / 2;
+        x -= width / 2;
         break;
     case TEXT_ALIGN_RIGHT:
-        rect.x = x - surface->w;
+        x -= width;
         break;
     }
 
-    SDL_RenderCopy(renderer, texture, 0, &rect);
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
+    font_atlas_draw(atlas, text, x, y, sdl_color);
 }
 
-static void draw_cell(SDL_Renderer *renderer, int row, int col, unsigned char value, int offset_x, int offset_y, bool outline)
+static void draw_cell(struct Render_Commands *commands, int row, int col, unsigned char value, int offset_x, int offset_y, bool outline)
 {
     struct Color base_color = BASE_COLORS[value];
     struct Color light_color = LIGHT_COLORS[value];
@@ -673,20 +749,21 @@ static void draw_cell(SDL_Renderer *renderer, int row, int col, unsigned char va
 
     if (outline)
     {
-        draw_rect(renderer, x, y, GRID_SIZE, GRID_SIZE, base_color);
+        draw_rect(commands, RENDER_LAYER_OUTLINE, x, y, GRID_SIZE, GRID_SIZE, base_color);
         return;
     }
 
-    fill_rect(renderer, x, y, GRID_SIZE, GRID_SIZE, dark_color);
-    fill_rect(renderer, x + edge, y, GRID_SIZE - edge, GRID_SIZE - edge, light_color);
-    fill_rect(renderer, x + edge, y + edge, GRID_SIZE - edge * 2, GRID_SIZE - edge * 2, base_color);
+    fill_rect(commands, RENDER_LAYER_CELL_DARK, x, y, GRID_SIZE, GRID_SIZE, dark_color);
+    fill_rect(commands, RENDER_LAYER_CELL_LIGHT, x + edge, y, GRID_SIZE - edge, GRID_SIZE - edge, light_color);
+    fill_rect(commands, RENDER_LAYER_CELL_BASE, x + edge, y + edge, GRID_SIZE - edge * 2, GRID_SIZE - edge * 2, base_color);
 }
 
 // Function to draw a Tetris piece on the game board
-// - renderer: SDL renderer used for rendering graphics
+// - commands: frame command buffer used for rendering graphics
 // - piece: Tetris piece structure
 // - x, y: Coordinates of the top-left corner of the piece on the game board
-static void draw_piece(SDL_Renderer *renderer, const struct Piece_State *piece, int offset_x, int offset_y, bool outline)
+// - min_row: cells above this row are not drawn
+static void draw_piece(struct Render_Commands *commands, const struct Piece_State *piece, int offset_x, int offset_y, int min_row, bool outline)
 {
     // Logic to draw each block of the Tetris piece on the game board
     const struct Tetrino *tetrino = TETRINOS + piece->tetrino_index;
@@ -695,228 +772,2368 @@ static void draw_piece(SDL_Renderer *renderer, const struct Piece_State *piece,
         for (int col = 0; col < tetrino->side; ++col)
         {
             unsigned char value = tetrino_get(tetrino, row, col, piece->rotation);
-            if (value)
+            if (value && row + piece->offset_row >= min_row)
             {
-                draw_cell(renderer, row + piece->offset_row, col + piece->offset_col, value, offset_x, offset_y, outline);
+                draw_cell(commands, row + piece->offset_row, col + piece->offset_col, value, offset_x, offset_y, outline);
             }
         }
     }
 }
 
-// Function to draw the game board grid and the falling piece
+// Locked cells of the board, kept in a render target texture between frames
+struct Board_Cache
+{
+    SDL_Texture *texture;
+    bool valid;
+    uint32_t revision;
+
+    // Copy of every row as it was last drawn into the texture
+    unsigned char rows[BOARD_MAX_HEIGHT * BOARD_STRIDE];
+    int redrawn_row_count;
+};
+
+// Function to create the board texture
+// - cache: cache to initialize
 // - renderer: SDL renderer used for rendering graphics
-// - board: 2D array representing the game board
-// - board_width, board_height: Width and height of the game board
+// - board: board whose visible rows are cached
+// If the texture cannot be created (e.g. a board taller than the maximum
+// texture size) the cache stays empty and the board is drawn every frame.
+static void board_cache_init(struct Board_Cache *cache, SDL_Renderer *renderer, const struct Board *board)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->texture = SDL_CreateTexture(
+        renderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_TARGET,
+        board->width * GRID_SIZE,
+        (board->height - BOARD_HIDDEN_ROWS) * GRID_SIZE);
+    SDL_SetTextureBlendMode(cache->texture, SDL_BLENDMODE_NONE);
+}
+
+static void board_cache_free(struct Board_Cache *cache)
+{
+    SDL_DestroyTexture(cache->texture);
+    memset(cache, 0, sizeof(*cache));
+}
+
+// Function to draw the background and the locked cells of one board row
+static void draw_board_row(struct Render_Commands *commands, const struct Board *board, int row, int offset_x, int offset_y)
+{
+    fill_rect(commands, RENDER_LAYER_BACKGROUND, offset_x, row * GRID_SIZE + offset_y, board->width * GRID_SIZE, GRID_SIZE, BASE_COLORS[0]);
+    if (board_row_empty(board, row))
+    {
+        return;
+    }
+
+    const unsigned char *cells = board_row(board, row);
+    for (int col = 0; col < board->width; ++col)
+    {
+        unsigned char value = cells[col];
+        if (value)
+        {
+            draw_cell(commands, row, col, value, offset_x, offset_y, false);
+        }
+    }
+}
+
+// Function to redraw the rows of the board texture that changed since the last frame
+// - cache: board cache to update
+// - commands: frame command buffer, must not hold commands of the current frame yet
+// - board: the game board
+static void update_board_cache(struct Board_Cache *cache, struct Render_Commands *commands, const struct Board *board)
+{
+    TRACE_SCOPE("update_board_cache");
+
+    cache->redrawn_row_count = 0;
+    if (!cache->texture || (cache->valid && cache->revision == board->revision))
+    {
+        return;
+    }
+
+    SDL_Renderer *renderer = commands->renderer;
+    SDL_SetRenderTarget(renderer, cache->texture);
+    render_commands_begin(commands);
+
+    // Hidden rows are never drawn, the texture starts at the first visible row
+    int offset_y = -BOARD_HIDDEN_ROWS * GRID_SIZE;
+    for (int row = BOARD_HIDDEN_ROWS; row < board->height; ++row)
+    {
+        const unsigned char *cells = board_row(board, row);
+        unsigned char *drawn_cells = cache->rows + row * BOARD_STRIDE;
+        if (cache->valid && memcmp(drawn_cells, cells, board->width) == 0)
+        {
+            continue;
+        }
+
+        memcpy(drawn_cells, cells, board->width);
+        draw_board_row(commands, board, row, 0, offset_y);
+        ++cache->redrawn_row_count;
+    }
+
+    render_commands_submit(commands);
+    SDL_SetRenderTarget(renderer, 0);
+
+    cache->valid = true;
+    cache->revision = board->revision;
+}
+
+// Function to draw the visible rows of the game board
+// - commands: frame command buffer used for rendering graphics
+// - cache: board texture, updated by update_board_cache
+// - board: the game board
 // - x_offset, y_offset: Offset for positioning the game board on the screen
-static void draw_board(SDL_Renderer *renderer, const unsigned char *board, int width, int height, int offset_x, int offset_y)
+static void draw_board(struct Render_Commands *commands, const struct Board_Cache *cache, const struct Board *board, int offset_x, int offset_y)
 {
-    // Logic to grid lines of the game board and render each block based on the board state
-    fill_rect(renderer, offset_x, offset_y, width * GRID_SIZE, height * GRID_SIZE, BASE_COLORS[0]);
-    for (int row = 0; row < height; ++row)
+    TRACE_SCOPE("draw_board");
+
+    if (!cache->texture)
     {
-        for (int col = 0; col < width; ++col)
+        for (int row = BOARD_HIDDEN_ROWS; row < board->height; ++row)
         {
-            unsigned char value = matrix_get(board, width, row, col);
-            if (value)
-            {
-                draw_cell(renderer, row, col, value, offset_x, offset_y, false);
-            }
+            draw_board_row(commands, board, row, offset_x, offset_y);
         }
+        return;
     }
+
+    SDL_Rect rect = {0};
+    rect.x = offset_x;
+    rect.y = offset_y + BOARD_HIDDEN_ROWS * GRID_SIZE;
+    rect.w = board->width * GRID_SIZE;
+    rect.h = (board->height - BOARD_HIDDEN_ROWS) * GRID_SIZE;
+    SDL_RenderCopy(commands->renderer, cache->texture, 0, &rect);
 }
 
 // Function to render the game graphics
 // - game: pointer to the game state structure
-// - renderer: SDL renderer used for rendering graphics
-// - font: TTF font used for rendering text
-static void render_game(const struct Game_State *game, SDL_Renderer *renderer, TTF_Font *font)
+// - piece_offset: pixel offset of the falling piece, for motion between simulation ticks
+// - commands: frame command buffer used for rendering graphics
+// - cache: retained texture of the locked board
+// - atlas: glyph atlas used for rendering text
+static void render_game(const struct Game_State *game, SDL_Point piece_offset, struct Render_Commands *commands, struct Board_Cache *cache, struct Font_Atlas *atlas)
 {
+    TRACE_SCOPE("render_game");
+
     char buffer[4096];
     struct Color highlight_color = {0xFF, 0xFF, 0xFF, 0xFF}; // Color for highlighting certain game elements
     int margin_y = 60;                                       // Margin between the top of the window and the game board
+    int width = game->board.width;
+    int height = game->board.height;
 
-    draw_board(renderer, game->board, WIDTH, HEIGHT, 0, margin_y); // Draw the game board and other game elements based on the current game state
+    // Only rows that changed since the last frame are redrawn into the board texture
+    update_board_cache(cache, commands, &game->board);
 
-    // Other rendering functions like draw_piece, draw_string, etc. are called here...
-    if (game->paused)
-    {
-        draw_string(renderer, font, "PAUSED", WIDTH * GRID_SIZE / 2, HEIGHT * GRID_SIZE / 2, TEXT_ALIGN_CENTER, (struct Color){255, 255, 255, 255});
-    }
+    // Board, pieces and overlays are recorded first and drawn in one batch, text goes on top
+    render_commands_begin(commands);
+
+    draw_board(commands, cache, &game->board, 0, margin_y); // Draw the game board and other game elements based on the current game state
 
     if (game->phase == GAME_PHASE_PLAY)
     {
-        draw_piece(renderer, &game->piece, 0, margin_y, false);
+        draw_piece(commands, &game->piece, piece_offset.x, margin_y + piece_offset.y, BOARD_HIDDEN_ROWS, false);
 
         struct Piece_State piece = game->piece;
-        while (check_piece_valid(&piece, game->board, WIDTH, HEIGHT))
+        while (check_piece_valid(&piece, &game->board))
         {
             piece.offset_row++;
         }
         --piece.offset_row;
 
-        draw_piece(renderer, &piece, 0, margin_y, true);
+        draw_piece(commands, &piece, piece_offset.x, margin_y, BOARD_HIDDEN_ROWS, true);
     }
 
-    // Additional rendering based on game phase (e.g., line clearing animation, game over screen)
+    // Additional rendering based on game phase (e.g., line clearing animation)
     if (game->phase == GAME_PHASE_LINE)
     {
-        for (int row = 0; row < HEIGHT; ++row)
+        for (int row = 0; row < height; ++row)
         {
             if (game->lines[row])
             {
                 int x = 0;
                 int y = row * GRID_SIZE + margin_y;
 
-                fill_rect(renderer, x, y, WIDTH * GRID_SIZE, GRID_SIZE, highlight_color);
-                Mix_PlayChannel(-1, clear_line_sound, 0);
+                fill_rect(commands, RENDER_LAYER_HIGHLIGHT, x, y, width * GRID_SIZE, GRID_SIZE, highlight_color);
+            }
+        }
+    }
+
+    // Nothing is drawn in the hidden rows, the next piece is shown there
+    commands->pass = RENDER_PASS_OVERLAY;
+
+    // Next piece in the hidden rows, right-aligned. Its first filled row is
+    // moved up to the top hidden row, no tetrino is taller than two rows
+    // unrotated, so the preview never covers a visible row.
+    if (game->phase == GAME_PHASE_PLAY || game->phase == GAME_PHASE_LINE)
+    {
+        struct Piece_State next_piece = {0};
+        next_piece.tetrino_index = peek_next_piece(game, 0);
+        const struct Tetrino *next = TETRINOS + next_piece.tetrino_index;
+        int first_row = next->side;
+        for (int cell = 0; cell < next->side * next->side; ++cell)
+        {
+            if (tetrino_get(next, cell / next->side, cell % next->side, 0) && cell / next->side < first_row)
+            {
+                first_row = cell / next->side;
             }
         }
+        next_piece.offset_row = -first_row;
+        int next_x = (width - next->side) * GRID_SIZE;
+        draw_piece(commands, &next_piece, next_x, margin_y, 0, false);
+    }
+
+    render_commands_submit(commands);
+
+    if (game->paused)
+    {
+        draw_string(atlas, "PAUSED", width * GRID_SIZE / 2, height * GRID_SIZE / 2, TEXT_ALIGN_CENTER, (struct Color){255, 255, 255, 255});
     }
-    else if (game->phase == GAME_PHASE_GAMEOVER)
+
+    if (game->phase == GAME_PHASE_GAMEOVER)
     {
-        int x = WIDTH * GRID_SIZE / 2;
-        int y = (HEIGHT * GRID_SIZE + margin_y) / 2;
-        draw_string(renderer, font, "GAME OVER", x, y, TEXT_ALIGN_CENTER, highlight_color);
+        int x = width * GRID_SIZE / 2;
+        int y = (height * GRID_SIZE + margin_y) / 2;
+        draw_string(atlas, "GAME OVER", x, y, TEXT_ALIGN_CENTER, highlight_color);
     }
     else if (game->phase == GAME_PHASE_START)
     {
-        int x = WIDTH * GRID_SIZE / 2;
-        int y = (HEIGHT * GRID_SIZE + margin_y) / 2;
-        draw_string(renderer, font, "PRESS START", x, y, TEXT_ALIGN_CENTER, highlight_color);
+        int x = width * GRID_SIZE / 2;
+        int y = (height * GRID_SIZE + margin_y) / 2;
+        draw_string(atlas, "PRESS START", x, y, TEXT_ALIGN_CENTER, highlight_color);
 
         snprintf(buffer, sizeof(buffer), "STARTING LEVEL: %d", game->start_level);
-        draw_string(renderer, font, buffer, x, y + 30, TEXT_ALIGN_CENTER, highlight_color);
+        draw_string(atlas, buffer, x, y + 30, TEXT_ALIGN_CENTER, highlight_color);
     }
 
-    // These are rendered based on the game state such as score, level, etc.
-    struct Color black_color = {0x00, 0x00, 0x00, 0x00};
-    fill_rect(renderer, 0, margin_y, WIDTH * GRID_SIZE, (HEIGHT - VISIBLE_HEIGHT) * GRID_SIZE, black_color);
-
     // Draw score, level, and other information on the screen
     snprintf(buffer, sizeof(buffer), "LEVEL: %d", game->level);
-    draw_string(renderer, font, buffer, 6, 6, TEXT_ALIGN_LEFT, highlight_color);
+    draw_string(atlas, buffer, 6, 6, TEXT_ALIGN_LEFT, highlight_color);
 
     snprintf(buffer, sizeof(buffer), "LINES: %d", game->line_count);
-    draw_string(renderer, font, buffer, 6, 35, TEXT_ALIGN_LEFT, highlight_color);
+    draw_string(atlas, buffer, 6, 35, TEXT_ALIGN_LEFT, highlight_color);
 
     snprintf(buffer, sizeof(buffer), "POINTS: %d", game->points);
-    draw_string(renderer, font, buffer, 6, 65, TEXT_ALIGN_LEFT, highlight_color);
+    draw_string(atlas, buffer, 6, 65, TEXT_ALIGN_LEFT, highlight_color);
 }
 
-int main(int argc, char *argv[])
+// Keys the game reacts to, packed as bits so they fit in one atomic
+enum Input_Key
 {
-    if (SDL_Init(SDL_INIT_VIDEO) < 0)
-    {
-        return 1;
-    }
+    INPUT_KEY_LEFT = 1 << 0,
+    INPUT_KEY_RIGHT = 1 << 1,
+    INPUT_KEY_UP = 1 << 2,
+    INPUT_KEY_DOWN = 1 << 3,
+    INPUT_KEY_A = 1 << 4
+};
 
-    if (TTF_Init() < 0)
+// Function to map a key to the INPUT_KEY bit it controls, 0 for other keys
+static int map_key(SDL_Scancode scancode)
+{
+    switch (scancode)
     {
-        return 2;
+    case SDL_SCANCODE_LEFT:
+        return INPUT_KEY_LEFT;
+    case SDL_SCANCODE_RIGHT:
+        return INPUT_KEY_RIGHT;
+    case SDL_SCANCODE_UP:
+        return INPUT_KEY_UP;
+    case SDL_SCANCODE_DOWN:
+        return INPUT_KEY_DOWN;
+    case SDL_SCANCODE_SPACE:
+        return INPUT_KEY_A;
+    default:
+        return 0;
     }
+}
 
-    SDL_Window *window = SDL_CreateWindow(
-        "Tetris",
-        SDL_WINDOWPOS_UNDEFINED,
-        SDL_WINDOWPOS_UNDEFINED,
-        300,
-        720,
-        SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
-    SDL_Renderer *renderer = SDL_CreateRenderer(
-        window,
-        -1,
-        SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+// Held keys and sideways auto-repeat, owned by the thread running the simulation
+struct Input_Tracker
+{
+    // INPUT_KEY bits of the keys held down
+    int keys;
 
-    // Load sound
-    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0)
+    // Delayed auto-shift and auto-repeat rate in milliseconds, an ARR of 0 shifts to the wall at once
+    int das_ms;
+    int arr_ms;
+
+    // Direction of the held sideways key, -1, 0 or 1, and when it shifts next
+    int repeat_direction;
+    Uint32 repeat_time;
+};
+
+static void input_tracker_init(struct Input_Tracker *tracker, int das_ms, int arr_ms)
+{
+    memset(tracker, 0, sizeof(*tracker));
+    tracker->das_ms = das_ms;
+    tracker->arr_ms = arr_ms;
+}
+
+// Function to collect the auto-repeat shifts that are due
+// - tracker: held keys and auto-repeat state
+// - now: current time in milliseconds
+// - returns the cells to shift, negative is left
+static int take_auto_repeat(struct Input_Tracker *tracker, Uint32 now)
+{
+    if (!tracker->repeat_direction || (Sint32)(now - tracker->repeat_time) < 0)
     {
-        printf("SDL_mixer could not initialize! SDL_mixer Error: %s\n", Mix_GetError());
-        return 1;
+        return 0;
     }
-
-    clear_line_sound = loadSound("sounds/clear.wav");
-    game_over_sound = loadSound("sounds/gameover.mp3");
-    theme_sound = loadSound("sounds/theme.mp3");
-    if (!clear_line_sound || !game_over_sound)
+    if (tracker->arr_ms <= 0)
     {
-        return 1;
+        return tracker->repeat_direction * BOARD_MAX_WIDTH;
     }
 
-    const char *font_name = "November.ttf";
-    TTF_Font *font = TTF_OpenFont(font_name, 24);
+    int count = 1 + (int)((now - tracker->repeat_time) / (Uint32)tracker->arr_ms);
+    tracker->repeat_time += (Uint32)(count * tracker->arr_ms);
+    return tracker->repeat_direction * count;
+}
 
-    struct Game_State game;
-    struct Input_State input;
+// Function to fill in the held key levels of an input state
+static void set_input_levels(struct Input_State *input, int keys)
+{
+    input->left = (keys & INPUT_KEY_LEFT) != 0;
+    input->right = (keys & INPUT_KEY_RIGHT) != 0;
+    input->up = (keys & INPUT_KEY_UP) != 0;
+    input->down = (keys & INPUT_KEY_DOWN) != 0;
+    input->a = (keys & INPUT_KEY_A) != 0;
+}
 
-    ZERO_STRUCT(game);
+// Function to apply one key event to the game at the time it happened
+// - game: game state, simulated up to the event first
+// - tracker: held keys and auto-repeat state
+// - event: the key event
+static void apply_input_event(struct Game_State *game, struct Input_Tracker *tracker, const struct Input_Event *event)
+{
+    struct Input_State input;
     ZERO_STRUCT(input);
+    input.shift = take_auto_repeat(tracker, event->timestamp);
 
-    spawn_piece(&game);
+    char delta = event->pressed ? 1 : -1;
+    tracker->keys = event->pressed ? (tracker->keys | event->key) : (tracker->keys & ~event->key);
+    set_input_levels(&input, tracker->keys);
 
-    game.piece.tetrino_index = 2;
+    switch (event->key)
+    {
+    case INPUT_KEY_LEFT:
+        input.dleft = delta;
+        break;
+    case INPUT_KEY_RIGHT:
+        input.dright = delta;
+        break;
+    case INPUT_KEY_UP:
+        input.dup = delta;
+        break;
+    case INPUT_KEY_DOWN:
+        input.ddown = delta;
+        break;
+    case INPUT_KEY_A:
+        input.da = delta;
+        break;
+    }
 
-    bool quit = false;
-    while (!quit)
+    // The last sideways key pressed wins, releasing it hands over to the other one if held
+    int direction = event->key == INPUT_KEY_LEFT ? -1 : (event->key == INPUT_KEY_RIGHT ? 1 : 0);
+    if (direction && event->pressed)
+    {
+        input.shift += direction;
+        tracker->repeat_direction = direction;
+        tracker->repeat_time = event->timestamp + tracker->das_ms;
+    }
+    else if (direction && tracker->repeat_direction == direction)
     {
-        game.time = SDL_GetTicks() / 1000.0f;
+        tracker->repeat_direction = input.left ? -1 : (input.right ? 1 : 0);
+        tracker->repeat_time = event->timestamp + tracker->das_ms;
+    }
 
-        SDL_Event e;
-        while (SDL_PollEvent(&e) != 0)
-        {
-            if (e.type == SDL_QUIT)
-            {
-                quit = true;
-            }
-            else if (e.type == SDL_KEYDOWN)
-            {
-                switch (e.key.keysym.sym)
-                {
-                case SDLK_ESCAPE:
-                    quit = true;
-                    break;
-                case SDLK_p:
-                    game.paused = !game.paused;
-                    break;
-                default:
-                    break;
-                }
-            }
-        }
+    struct Piece_State previous_piece = game->piece;
+    enum Game_Phase previous_phase = game->phase;
+    int previous_start_level = game->start_level;
 
-        int key_count;
-        const unsigned char *key_states = SDL_GetKeyboardState(&key_count);
+    // Events are stamped when SDL queues them, which can be just before the last update
+    double time = event->timestamp / 1000.0;
+    game->time = time > game->time ? time : game->time;
+    update_game(game, &input);
 
-        struct Input_State prev_input = input;
+    bool changed = memcmp(&game->piece, &previous_piece, sizeof(previous_piece)) != 0 ||
+                   game->phase != previous_phase || game->start_level != previous_start_level;
+    if (changed && !game->input_polled_at)
+    {
+        game->input_polled_at = event->polled_at;
+    }
+}
 
-        input.left = key_states[SDL_SCANCODE_LEFT];
-        input.right = key_states[SDL_SCANCODE_RIGHT];
-        input.up = key_states[SDL_SCANCODE_UP];
-        input.down = key_states[SDL_SCANCODE_DOWN];
-        input.a = key_states[SDL_SCANCODE_SPACE];
+// Function to run the game up to a point in time
+// Queued key events up to that time are applied in order, each at its own timestamp.
+// - game: game state to update
+// - tracker: held keys and auto-repeat state
+// - queue: key events from the main thread
+// - now: time to simulate up to, in milliseconds
+// - returns the number of key events applied
+static int run_input(struct Game_State *game, struct Input_Tracker *tracker, struct Input_Queue *queue, Uint32 now)
+{
+    int event_count = 0;
+    struct Input_Event event;
+    while (input_queue_peek(queue, &event) && (Sint32)(event.timestamp - now) <= 0)
+    {
+        input_queue_pop(queue);
+        apply_input_event(game, tracker, &event);
+        ++event_count;
+    }
 
-        input.dleft = (char)input.left - (char)prev_input.left;
-        input.dright = (char)input.right - (char)prev_input.right;
-        input.dup = (char)input.up - (char)prev_input.up;
-        input.ddown = (char)input.down - (char)prev_input.down;
-        input.da = (char)input.a - (char)prev_input.a;
+    struct Input_State input;
+    ZERO_STRUCT(input);
+    set_input_levels(&input, tracker->keys);
+    input.shift = take_auto_repeat(tracker, now);
 
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
-        SDL_RenderClear(renderer);
+    game->time = now / 1000.0;
+    update_game(game, &input);
+    return event_count;
+}
 
-        // Update and render the game
-        update_game(&game, &input);
-        render_game(&game, renderer, font);
+// Game state published by the simulation thread after every tick
+struct Game_Snapshot
+{
+    struct Game_State game;
+    struct Piece_State previous_piece;
+    Uint64 published_at;
+};
 
-        SDL_RenderPresent(renderer);
-    }
+// Simulation running on its own thread at exactly 60 ticks per second
+struct Simulation
+{
+    struct Game_State game;
+
+    struct Game_Snapshot snapshot_slots[3];
+    struct Triple_Buffer snapshots;
+
+    // Written by the main thread, read by the simulation thread
+    struct Input_Queue input_queue;
+    SDL_atomic_t pause_toggles;
+    SDL_atomic_t quit;
+
+    // Pushed when a static screen needs to be redrawn
+    Uint32 redraw_event;
+
+    // Only used by the simulation thread while it runs
+    struct Audio *audio;
+    struct Input_Tracker input;
+};
+
+static int run_simulation(void *data)
+{
+    struct Simulation *simulation = (struct Simulation *)data;
+    struct Game_State *game = &simulation->game;
+    trace_thread_name("simulation");
+
+    // Ticks are scheduled from the start time so rounding never accumulates
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint32 start_ms = (Uint32)(game->time * 1000.0);
+
+    for (Uint64 tick = 1; !SDL_AtomicGet(&simulation->quit); ++tick)
+    {
+        struct Piece_State previous_piece = game->piece;
+        enum Game_Phase previous_phase = game->phase;
+        bool previous_paused = game->paused;
+
+        if (SDL_AtomicSet(&simulation->pause_toggles, 0) & 1)
+        {
+            game->paused = !game->paused;
+        }
+
+        Uint32 now = start_ms + (Uint32)(tick * 1000 / 60);
+        int event_count = run_input(game, &simulation->input, &simulation->input_queue, now);
+        audio_play(simulation->audio, game->audio_events);
+        game->audio_events = 0;
+
+        struct Game_Snapshot *snapshot = (struct Game_Snapshot *)triple_buffer_back(&simulation->snapshots);
+        snapshot->game = *game;
+        snapshot->previous_piece = previous_piece;
+        snapshot->published_at = SDL_GetPerformanceCounter();
+        triple_buffer_publish(&simulation->snapshots);
+        game->input_polled_at = 0;
+
+        // Static screens only redraw on events, tell the main thread when they changed
+        if (event_count > 0 || game->phase != previous_phase || game->paused != previous_paused)
+        {
+            SDL_Event event;
+            SDL_zero(event);
+            event.type = simulation->redraw_event;
+            SDL_PushEvent(&event);
+        }
+
+        frame_pacer_wait_until(start + tick * frequency / 60);
+    }
+    return 0;
+}
+
+// Function to find where the falling piece is between two simulation ticks
+// - snapshot: latest snapshot from the simulation thread
+// - returns the pixel offset from the piece's current cell position
+static SDL_Point interpolate_piece(const struct Game_Snapshot *snapshot)
+{
+    SDL_Point offset = {0, 0};
+    const struct Piece_State *piece = &snapshot->game.piece;
+    const struct Piece_State *previous = &snapshot->previous_piece;
+
+    // Only single-cell moves of the same piece are smoothed, spawns and hard drops snap
+    int delta_row = previous->offset_row - piece->offset_row;
+    int delta_col = previous->offset_col - piece->offset_col;
+    if (previous->tetrino_index != piece->tetrino_index || previous->rotation != piece->rotation ||
+        delta_row < -1 || delta_row > 1 || delta_col < -1 || delta_col > 1)
+    {
+        return offset;
+    }
+
+    double elapsed = (double)(SDL_GetPerformanceCounter() - snapshot->published_at) / SDL_GetPerformanceFrequency();
+    double remaining = 1.0 - elapsed / TARGET_SECONDS_PER_FRAME;
+    if (remaining <= 0)
+    {
+        return offset;
+    }
+
+    offset.x = (int)(delta_col * GRID_SIZE * remaining);
+    offset.y = (int)(delta_row * GRID_SIZE * remaining);
+    return offset;
+}
+
+// Sounds and font, loaded on a background thread so the window shows up right away
+struct Assets
+{
+    // Every asset is read from here, it stays mapped until the assets are freed
+    struct Asset_Pack pack;
+
+    const char *font_name;
+    TTF_Font *font;
+
+    bool audio_open;
+    Mix_Chunk *line_clear;
+    Mix_Music *theme;
+    Mix_Music *game_over;
+
+    // Receives the sounds once they are loaded
+    struct Audio *audio;
+
+    // Pushed when loading finished
+    Uint32 loaded_event;
+    Uint64 start;
+    double load_ms;
+
+    // Set when loading finished, successfully or not
+    SDL_atomic_t done;
+};
+
+// Function to load the font and the sounds, runs on the asset thread
+// A missing font is reported through assets->font, without sound the game runs silently.
+static int load_assets(void *data)
+{
+    struct Assets *assets = (struct Assets *)data;
+    trace_thread_name("assets");
+
+    // A pack next to the executable, else the pack linked into the binary, else loose files
+    char *base_path = SDL_GetBasePath();
+    char pack_path[1024];
+    snprintf(pack_path, sizeof(pack_path), "%s%s", base_path ? base_path : "", ASSET_PACK_FILENAME);
+    SDL_free(base_path);
+
+    const char *source = "loose files";
+    if (asset_pack_open(&assets->pack, pack_path))
+    {
+        source = pack_path;
+    }
+#ifdef ASSET_PACK_EMBEDDED
+    else if (asset_pack_open_memory(&assets->pack, ASSET_PACK_DATA, sizeof(ASSET_PACK_DATA)))
+    {
+        source = "embedded pack";
+    }
+#endif
+    printf("assets: loading from %s\n", source);
+
+    // The font comes first, the start screen needs it
+    assets->font = TTF_OpenFontRW(asset_pack_open_rw(&assets->pack, assets->font_name), 1, 24);
+    if (!assets->font)
+    {
+        printf("Failed to load font: %s\n", TTF_GetError());
+    }
+
+    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0)
+    {
+        printf("SDL_mixer could not initialize! SDL_mixer Error: %s\n", Mix_GetError());
+    }
+    else
+    {
+        // Only the short effect is decoded up front, music is streamed
+        assets->audio_open = true;
+        assets->line_clear = loadSound(&assets->pack, "sounds/clear.wav");
+        assets->game_over = loadMusic(&assets->pack, "sounds/gameover.mp3");
+        assets->theme = loadMusic(&assets->pack, "sounds/theme.mp3");
+        audio_set_sounds(assets->audio, assets->theme, assets->game_over, assets->line_clear);
+    }
+
+    assets->load_ms = (double)(SDL_GetPerformanceCounter() - assets->start) * 1000.0 / SDL_GetPerformanceFrequency();
+    SDL_AtomicSet(&assets->done, 1);
+
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = assets->loaded_event;
+    SDL_PushEvent(&event);
+    return 0;
+}
+
+// Function to fill the board with a ragged stack for benchmarking
+// - game: game state to set up, it is left in the play phase
+// - first_row: top row of the stack
+static void fill_benchmark_board(struct Game_State *game, int first_row)
+{
+    struct Random rng;
+    random_seed(&rng, 1);
+
+    struct Board *board = &game->board;
+    board_clear(board);
+    for (int row = first_row; row < board->height; ++row)
+    {
+        int gap = (int)random_below(&rng, (uint32_t)board->width);
+        for (int col = 0; col < board->width; ++col)
+        {
+            if (col != gap && random_below(&rng, 4) != 0)
+            {
+                board_set(board, row, col, (unsigned char)(1 + random_below(&rng, RANDOMIZER_PIECE_COUNT)));
+            }
+        }
+    }
+
+    game->phase = GAME_PHASE_PLAY;
+    game->paused = false;
+    spawn_piece(game);
+}
+
+// Function to start a frame benchmark scenario
+// - game: game state to set up, it is left in the play phase
+// - scenario: situation to set up
+static void setup_bench_scenario(struct Game_State *game, enum Frame_Bench_Scenario scenario)
+{
+    game->start_level = scenario == FRAME_BENCH_SCENARIO_KILL_SCREEN ? RULESET_LEVEL_COUNT - 1 : 0;
+    game->level = game->start_level;
+    game->line_count = 0;
+    game->points = 0;
+    if (scenario == FRAME_BENCH_SCENARIO_STACK)
+    {
+        // Room for a few pieces above the stack before it tops out
+        fill_benchmark_board(game, 6);
+        return;
+    }
+
+    board_clear(&game->board);
+    game->phase = GAME_PHASE_PLAY;
+    game->paused = false;
+    spawn_piece(game);
+}
+
+// Function to fill the rows the falling piece will land on, except the cells it covers
+// Only rows the piece can still drop into are filled, so dropping it straight down clears
+// each of them: no cell lower in the piece may be in a column the row does not cover.
+static void fill_rows_under_piece(struct Game_State *game)
+{
+    struct Piece_State landed = game->piece;
+    while (check_piece_valid(&landed, &game->board))
+    {
+        ++landed.offset_row;
+    }
+    --landed.offset_row;
+
+    // Columns covered by each row of the piece, and by the rows below it
+    const struct Tetrino *tetrino = TETRINOS + landed.tetrino_index;
+    unsigned row_columns[4] = {0};
+    for (int row = 0; row < tetrino->side; ++row)
+    {
+        for (int col = 0; col < tetrino->side; ++col)
+        {
+            row_columns[row] |= tetrino_get(tetrino, row, col, landed.rotation) ? 1u << col : 0;
+        }
+    }
+
+    unsigned columns_below = 0;
+    for (int row = tetrino->side - 1; row >= 0; --row)
+    {
+        unsigned columns = row_columns[row];
+        if (columns && (columns_below & ~columns) == 0)
+        {
+            for (int board_col = 0; board_col < game->board.width; ++board_col)
+            {
+                int col = board_col - landed.offset_col;
+                if (col < 0 || col >= tetrino->side || !(columns & (1u << col)))
+                {
+                    board_set(&game->board, landed.offset_row + row, board_col, (unsigned char)(1 + board_col % RANDOMIZER_PIECE_COUNT));
+                }
+            }
+        }
+        columns_below |= columns;
+    }
+}
+
+// Function to keep a benchmark scenario going, called before each frame
+// - game: game state driven by the benchmark
+// - bench: the benchmark, counts restarts
+// - rows_filled: set while the falling piece has its rows filled, only used by the clears scenario
+static void update_bench_scenario(struct Game_State *game, struct Frame_Bench *bench, bool *rows_filled)
+{
+    if (game->phase == GAME_PHASE_GAMEOVER)
+    {
+        setup_bench_scenario(game, bench->scenario);
+        ++bench->restart_count;
+        *rows_filled = false;
+    }
+
+    if (bench->scenario == FRAME_BENCH_SCENARIO_CLEARS)
+    {
+        if (game->phase == GAME_PHASE_PLAY && !*rows_filled)
+        {
+            fill_rows_under_piece(game);
+            *rows_filled = true;
+        }
+        else if (game->phase == GAME_PHASE_LINE)
+        {
+            *rows_filled = false;
+        }
+    }
+}
+
+// Function to compare the SDL_Renderer path with the software raster path
+// - game: game state to render, in the play phase
+// - font: TTF font used for the HUD
+// - frame_count: number of frames rendered with each backend and scene
+// Both backends render into SDL's software renderer on an offscreen surface,
+// the result is timed and checked to be identical pixel for pixel. The play
+// scene covers the pieces, the ghost outline and the preview, a copy of it in
+// the line clear phase covers the highlight rows.
+// - returns 1 if any pixel differs
+static int run_raster_benchmark(const struct Game_State *game, TTF_Font *font, int frame_count)
+{
+    int width = game->board.width * GRID_SIZE;
+    int height = game->board.height * GRID_SIZE + 60;
+    const char *backend_names[] = {"sdl", "raster"};
+    const char *scene_names[] = {"play", "line clear"};
+    SDL_Surface *surfaces[2] = {0};
+    double milliseconds[2] = {0};
+
+    struct Game_State line_game = *game;
+    line_game.phase = GAME_PHASE_LINE;
+    for (int row = line_game.board.height - 2; row < line_game.board.height; ++row)
+    {
+        line_game.lines[row] = 1;
+    }
+    const struct Game_State *scenes[] = {game, &line_game};
+
+    for (int backend = 0; backend < 2; ++backend)
+    {
+        surfaces[backend] = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    }
+
+    int mismatch_count = 0;
+    for (int scene = 0; scene < (int)ARRAY_COUNT(scenes); ++scene)
+    {
+        for (int backend = 0; backend < 2; ++backend)
+        {
+            SDL_Renderer *renderer = surfaces[backend] ? SDL_CreateSoftwareRenderer(surfaces[backend]) : 0;
+            if (!renderer)
+            {
+                printf("Failed to create benchmark renderer: %s\n", SDL_GetError());
+                SDL_FreeSurface(surfaces[0]);
+                SDL_FreeSurface(surfaces[1]);
+                return 1;
+            }
+
+            struct Font_Atlas atlas;
+            struct Render_Commands commands;
+            struct Board_Cache board_cache;
+            struct Raster raster;
+            ZERO_STRUCT(board_cache);
+            ZERO_STRUCT(raster);
+            font_atlas_init(&atlas, renderer, font);
+            render_commands_init(&commands, renderer, 1024);
+            if (backend == 0)
+            {
+                board_cache_init(&board_cache, renderer, &scenes[scene]->board);
+            }
+            else
+            {
+                raster_init(&raster, renderer, width, height);
+                commands.raster = &raster;
+            }
+
+            Uint64 start = SDL_GetPerformanceCounter();
+            for (int frame = 0; frame < frame_count; ++frame)
+            {
+                SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+                SDL_RenderClear(renderer);
+                SDL_Point no_offset = {0, 0};
+                render_game(scenes[scene], no_offset, &commands, &board_cache, &atlas);
+                SDL_RenderPresent(renderer);
+            }
+            Uint64 end = SDL_GetPerformanceCounter();
+            milliseconds[backend] += (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+            raster_free(&raster);
+            board_cache_free(&board_cache);
+            render_commands_free(&commands);
+            font_atlas_free(&atlas);
+            SDL_DestroyRenderer(renderer);
+        }
+
+        // Alpha is not shown on screen, only color channels have to match
+        int scene_mismatch_count = 0;
+        for (int y = 0; y < height; ++y)
+        {
+            const uint32_t *row_a = (const uint32_t *)((const unsigned char *)surfaces[0]->pixels + y * surfaces[0]->pitch);
+            const uint32_t *row_b = (const uint32_t *)((const unsigned char *)surfaces[1]->pixels + y * surfaces[1]->pitch);
+            for (int x = 0; x < width; ++x)
+            {
+                if ((row_a[x] & 0x00FFFFFF) != (row_b[x] & 0x00FFFFFF))
+                {
+                    if (scene_mismatch_count == 0)
+                    {
+                        printf("%s: first mismatch at %d,%d: sdl %06X raster %06X\n",
+                               scene_names[scene], x, y, (unsigned)(row_a[x] & 0x00FFFFFF), (unsigned)(row_b[x] & 0x00FFFFFF));
+                    }
+                    ++scene_mismatch_count;
+                }
+            }
+        }
+        mismatch_count += scene_mismatch_count;
+    }
+
+    for (int backend = 0; backend < 2; ++backend)
+    {
+        printf("%-6s %8.3f ms/frame over %d frames\n", backend_names[backend], milliseconds[backend] / (frame_count * ARRAY_COUNT(scenes)), frame_count * (int)ARRAY_COUNT(scenes));
+        SDL_FreeSurface(surfaces[backend]);
+    }
+    printf("speedup %.2fx, %d mismatching pixels: %s\n", milliseconds[0] / milliseconds[1], mismatch_count, mismatch_count == 0 ? "identical" : "FAILED");
+    return mismatch_count == 0 ? 0 : 1;
+}
+
+// Function to count the empty cells with a filled cell somewhere above them
+static int count_board_holes(const struct Board *board)
+{
+    int hole_count = 0;
+    uint16_t covered = 0;
+    for (int row = board->stack_top; row < board->height; ++row)
+    {
+        uint16_t mask = board_row_mask(board, row);
+        hole_count += __builtin_popcount(covered & ~mask & board->full_mask);
+        covered |= mask;
+    }
+    return hole_count;
+}
+
+// Function to take a piece merged by merge_piece back off the board
+// The piece only covered empty cells, so clearing its cells and restoring the
+// stack top undoes the merge without saving the board.
+// - game: game whose current piece was merged
+// - stack_top, revision: values of the board before the merge
+static void unmerge_piece(struct Game_State *game, int stack_top, uint32_t revision)
+{
+    const struct Tetrino *tetrino = TETRINOS + game->piece.tetrino_index;
+    for (int row = 0; row < tetrino->side; ++row)
+    {
+        for (int col = 0; col < tetrino->side; ++col)
+        {
+            if (tetrino_get(tetrino, row, col, game->piece.rotation))
+            {
+                board_set(&game->board, game->piece.offset_row + row, game->piece.offset_col + col, 0);
+            }
+        }
+    }
+    game->board.stack_top = stack_top;
+    game->board.revision = revision;
+}
+
+// One placement considered by self-play
+struct Self_Play_Node
+{
+    struct Piece_State piece;
+    float score;
+    struct Self_Play_Node *next;
+};
+
+// Function to place the falling piece for self-play and spawn the next one
+// Every rotation and column the piece fits into at the top is dropped straight down and
+// scored by stack height and holes, with a little noise so games differ. Random
+// placements grow the stack and leave holes. The placements are nodes in the arena,
+// which is reset once the piece locks.
+// - game: game in the play phase, the piece is merged and lines are cleared
+// - arena: holds the placements of this move
+// - rng: source of the noise
+// - random_percent: chance of placing the piece anywhere instead of in a good spot
+// - returns false when the game is over
+static bool self_play_step(struct Game_State *game, struct Arena *arena, struct Random *rng, int random_percent)
+{
+    bool random_placement = (int)random_below(rng, 100) < random_percent;
+    struct Self_Play_Node *first = 0;
+    struct Self_Play_Node *last = 0;
+    for (int rotation = 0; rotation < 4; ++rotation)
+    {
+        for (int col = -3; col < game->board.width; ++col)
+        {
+            struct Piece_State piece = game->piece;
+            piece.rotation = rotation;
+            piece.offset_col = col;
+            if (!check_piece_valid(&piece, &game->board))
+            {
+                continue;
+            }
+            while (check_piece_valid(&piece, &game->board))
+            {
+                ++piece.offset_row;
+            }
+            --piece.offset_row;
+
+            float score = (float)random_below(rng, 1000);
+            if (!random_placement)
+            {
+                // Lower stacks and fewer holes score higher
+                int saved_stack_top = game->board.stack_top;
+                uint32_t saved_revision = game->board.revision;
+                struct Piece_State saved_piece = game->piece;
+                game->piece = piece;
+                merge_piece(game);
+                int holes = count_board_holes(&game->board);
+                int stack_top = game->board.stack_top;
+                unmerge_piece(game, saved_stack_top, saved_revision);
+                game->piece = saved_piece;
+                score = stack_top * 10.0f - holes * 30.0f + piece.offset_row * 2.0f + score * 0.002f;
+            }
+
+            // Out of memory only narrows the search
+            struct Self_Play_Node *node = ARENA_PUSH_NODE(arena, struct Self_Play_Node);
+            if (!node)
+            {
+                continue;
+            }
+            node->piece = piece;
+            node->score = score;
+            node->next = 0;
+            if (last)
+            {
+                last->next = node;
+            }
+            else
+            {
+                first = node;
+            }
+            last = node;
+        }
+    }
+    if (!first)
+    {
+        return false;
+    }
+
+    const struct Self_Play_Node *best = first;
+    for (const struct Self_Play_Node *node = first->next; node; node = node->next)
+    {
+        if (node->score > best->score)
+        {
+            best = node;
+        }
+    }
+
+    game->piece = best->piece;
+    arena_reset(arena);
+    merge_piece(game);
+    if (find_lines(&game->board, game->lines) > 0)
+    {
+        clear_lines(&game->board, game->lines);
+    }
+    spawn_piece(game);
+    return board_row_empty(&game->board, 0) && check_piece_valid(&game->piece, &game->board);
+}
+
+// Function to generate the engine benchmark corpus by seeded self-play
+// - corpus: corpus to fill, boards_per_category boards of every category
+// - rules: rules the games are played with
+// - seed: seed of the piece sequence and the placement noise
+// - width, height: board size
+// - returns false if out of memory, the corpus is freed then
+static bool generate_board_corpus(struct Board_Corpus *corpus, const struct Ruleset *rules, uint32_t seed, int width, int height, int boards_per_category)
+{
+    if (!board_corpus_init(corpus, width, height, boards_per_category * BOARD_CORPUS_CATEGORY_COUNT))
+    {
+        board_corpus_free(corpus);
+        return false;
+    }
+    corpus->seed = seed;
+
+    struct Game_State *game = (struct Game_State *)calloc(1, sizeof(struct Game_State));
+    if (!game)
+    {
+        board_corpus_free(corpus);
+        return false;
+    }
+    game->rules = rules;
+    board_init(&game->board, width, height);
+
+    // A move considers at most 4 rotations of every column, far below one block
+    struct Arena arena;
+    if (!arena_init(&arena, 64 * 1024))
+    {
+        free(game);
+        board_corpus_free(corpus);
+        return false;
+    }
+
+    int index = 0;
+    for (int category = 0; category < BOARD_CORPUS_CATEGORY_COUNT; ++category)
+    {
+        // Every category plays from its own stream of the seed, so how long one
+        // category plays does not change the boards of the next
+        struct Random rng;
+        random_seed_stream(&rng, seed, (unsigned int)category);
+        reset_piece_queue(game, RANDOMIZER_NES, &rng);
+        board_clear(&game->board);
+        spawn_piece(game);
+
+        int found = 0;
+        for (int step = 0; found < boards_per_category && step < 1000000; ++step)
+        {
+            // Sampling only every few pieces keeps consecutive boards apart
+            const struct Board *board = &game->board;
+            int stack_height = board->height - board->stack_top;
+            bool take = step % 3 == 0;
+            switch (category)
+            {
+            case BOARD_CORPUS_EMPTY:
+                take = true;
+                break;
+            case BOARD_CORPUS_RAGGED:
+                take = take && stack_height >= 4 && stack_height <= board->height / 2;
+                break;
+            case BOARD_CORPUS_NEAR_TOP_OUT:
+                take = take && board->stack_top >= BOARD_HIDDEN_ROWS && board->stack_top < BOARD_HIDDEN_ROWS + 4;
+                break;
+            case BOARD_CORPUS_HOLES:
+                take = take && count_board_holes(board) >= 2 * board->width && board->stack_top >= BOARD_HIDDEN_ROWS + 2;
+                break;
+            }
+            if (take)
+            {
+                corpus->boards[index] = *board;
+                corpus->categories[index] = (unsigned char)category;
+                ++index;
+                ++found;
+                if (category == BOARD_CORPUS_EMPTY)
+                {
+                    continue;
+                }
+            }
+
+            // Placement gets worse from ragged to near top-out to many holes
+            static const int RANDOM_PERCENTS[BOARD_CORPUS_CATEGORY_COUNT] = {0, 10, 40, 100};
+            if (!self_play_step(game, &arena, &rng, RANDOM_PERCENTS[category]))
+            {
+                board_clear(&game->board);
+                spawn_piece(game);
+            }
+        }
+        if (found < boards_per_category)
+        {
+            printf("corpus: only %d %s boards found\n", found, BOARD_CORPUS_CATEGORY_NAMES[category]);
+        }
+    }
+
+    // Short categories leave the boards packed, the corpus keeps only those found
+    corpus->count = index;
+    arena_print_stats(&arena, "corpus: self-play arena", stdout);
+    arena_free(&arena);
+    free(game);
+    return true;
+}
+
+enum Engine_Benchmark
+{
+    ENGINE_BENCHMARK_CHECK_PIECE_VALID,
+    ENGINE_BENCHMARK_MERGE_PIECE,
+    ENGINE_BENCHMARK_FIND_LINES,
+    ENGINE_BENCHMARK_CLEAR_LINES,
+    ENGINE_BENCHMARK_TETRINO_GET,
+    ENGINE_BENCHMARK_UPDATE_GAME_PLAY,
+
+    ENGINE_BENCHMARK_COUNT
+};
+
+static const char *ENGINE_BENCHMARK_NAMES[ENGINE_BENCHMARK_COUNT] = {
+    "check_piece_valid", "merge_piece", "find_lines", "clear_lines", "tetrino_get", "update_game_play"};
+
+// Function to restore the part of a board in use, much cheaper than copying the whole struct
+static void restore_board_rows(struct Board *board, const struct Board *source)
+{
+    board->stack_top = source->stack_top;
+    memcpy(board->rows, source->rows, sizeof(board->rows[0]) * source->height);
+    memcpy(board->masks, source->masks, sizeof(board->masks[0]) * source->height);
+    memcpy(board->cells, source->cells, BOARD_STRIDE * source->height);
+}
+
+// Function to run one pass of an engine benchmark over the whole corpus
+// - benchmark: function to measure
+// - corpus: boards to run on
+// - game: scratch game state, its board is overwritten
+// - sink: receives results so the calls cannot be optimized out
+// - returns the number of operations done
+static int run_engine_pass(enum Engine_Benchmark benchmark, const struct Board_Corpus *corpus, struct Game_State *game, int *sink)
+{
+    int op_count = 0;
+    for (int i = 0; i < corpus->count; ++i)
+    {
+        const struct Board *source = corpus->boards + i;
+        struct Piece_State piece;
+        ZERO_STRUCT(piece);
+        switch (benchmark)
+        {
+        case ENGINE_BENCHMARK_CHECK_PIECE_VALID:
+            // Every piece, rotation and column just above the stack, where collisions are tested in play
+            piece.offset_row = source->stack_top > 2 ? source->stack_top - 2 : 0;
+            for (int tetrino = 0; tetrino < RANDOMIZER_PIECE_COUNT; ++tetrino)
+            {
+                piece.tetrino_index = (unsigned char)tetrino;
+                for (piece.rotation = 0; piece.rotation < 4; ++piece.rotation)
+                {
+                    for (piece.offset_col = -2; piece.offset_col < source->width; ++piece.offset_col)
+                    {
+                        *sink += check_piece_valid(&piece, source);
+                        ++op_count;
+                    }
+                }
+            }
+            break;
+        case ENGINE_BENCHMARK_MERGE_PIECE:
+            // Restoring the rows in use is timed too
+            restore_board_rows(&game->board, source);
+            for (int tetrino = 0; tetrino < RANDOMIZER_PIECE_COUNT; ++tetrino)
+            {
+                game->piece.tetrino_index = (unsigned char)tetrino;
+                game->piece.rotation = 0;
+                game->piece.offset_col = source->width / 2 - 1;
+                game->piece.offset_row = source->stack_top > 4 ? source->stack_top - 4 : 0;
+                merge_piece(game);
+                ++op_count;
+            }
+            *sink += (int)game->board.revision;
+            break;
+        case ENGINE_BENCHMARK_FIND_LINES:
+            *sink += find_lines(source, game->lines);
+            ++op_count;
+            break;
+        case ENGINE_BENCHMARK_CLEAR_LINES:
+            // Clears the bottom four rows whether or not they are filled, restoring the rows in use is timed too
+            restore_board_rows(&game->board, source);
+            memset(game->lines, 0, source->height);
+            memset(game->lines + source->height - 4, 1, 4);
+            clear_lines(&game->board, game->lines);
+            *sink += game->board.stack_top;
+            ++op_count;
+            break;
+        case ENGINE_BENCHMARK_TETRINO_GET:
+            for (int tetrino = 0; tetrino < RANDOMIZER_PIECE_COUNT; ++tetrino)
+            {
+                const struct Tetrino *shape = TETRINOS + tetrino;
+                for (int rotation = 0; rotation < 4; ++rotation)
+                {
+                    for (int cell = 0; cell < shape->side * shape->side; ++cell)
+                    {
+                        *sink += tetrino_get(shape, cell / shape->side, cell % shape->side, rotation);
+                        ++op_count;
+                    }
+                }
+            }
+            break;
+        case ENGINE_BENCHMARK_UPDATE_GAME_PLAY:
+        {
+            // A rotation, a shift and one gravity step from the spawn position
+            struct Input_State input;
+            ZERO_STRUCT(input);
+            input.dup = 1;
+            input.shift = (i & 1) ? 1 : -1;
+            restore_board_rows(&game->board, source);
+            game->phase = GAME_PHASE_PLAY;
+            game->piece = piece;
+            game->piece.tetrino_index = (unsigned char)(i % RANDOMIZER_PIECE_COUNT);
+            game->piece.offset_col = source->width / 2;
+            game->next_drop_time = game->time;
+            update_game_play(game, &input);
+            *sink += game->piece.offset_row + game->phase;
+            ++op_count;
+            break;
+        }
+        case ENGINE_BENCHMARK_COUNT:
+            break;
+        }
+    }
+    return op_count;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Function to time the engine functions over a board corpus
+// Each benchmark repeats passes until a sample takes ENGINE_BENCHMARK_SAMPLE_MS and takes
+// ENGINE_BENCHMARK_SAMPLE_COUNT samples; the fastest sample is the result, which is the
+// figure least disturbed by other processes and the one to gate on.
+// - corpus_filename: board corpus to run on
+// - rules: rules the update step uses
+// - thresholds_filename: file with "engine <function> <max ns/op>" lines, or 0
+// - returns the exit code, 1 if the corpus cannot be read or a threshold is exceeded
+static int run_engine_benchmark(const char *corpus_filename, const struct Ruleset *rules, const char *thresholds_filename)
+{
+    struct Board_Corpus corpus;
+    if (!board_corpus_read(&corpus, corpus_filename))
+    {
+        return 1;
+    }
+
+    int category_counts[BOARD_CORPUS_CATEGORY_COUNT] = {0};
+    for (int i = 0; i < corpus.count; ++i)
+    {
+        ++category_counts[corpus.categories[i]];
+    }
+    printf("engine bench: %d boards of %dx%d from seed %u (", corpus.count, corpus.width, corpus.height, corpus.seed);
+    for (int category = 0; category < BOARD_CORPUS_CATEGORY_COUNT; ++category)
+    {
+        printf("%s%d %s", category ? ", " : "", category_counts[category], BOARD_CORPUS_CATEGORY_NAMES[category]);
+    }
+    printf(")\n");
+
+    struct Game_State *game = (struct Game_State *)calloc(1, sizeof(struct Game_State));
+    if (!game)
+    {
+        board_corpus_free(&corpus);
+        return 1;
+    }
+    game->rules = rules;
+    board_init(&game->board, corpus.width, corpus.height);
+    struct Random rng;
+    random_seed(&rng, 1);
+    reset_piece_queue(game, RANDOMIZER_NES, &rng);
+
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    double ns_per_op[ENGINE_BENCHMARK_COUNT];
+    int sink = 0;
+    for (int benchmark = 0; benchmark < ENGINE_BENCHMARK_COUNT; ++benchmark)
+    {
+        // Warm up and find how many passes fill one sample
+        int passes = 1;
+        for (;;)
+        {
+            Uint64 start = SDL_GetPerformanceCounter();
+            for (int pass = 0; pass < passes; ++pass)
+            {
+                run_engine_pass((enum Engine_Benchmark)benchmark, &corpus, game, &sink);
+            }
+            double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+            if (ms >= ENGINE_BENCHMARK_SAMPLE_MS || passes >= (1 << 24))
+            {
+                break;
+            }
+            passes *= 2;
+        }
+
+        double samples[ENGINE_BENCHMARK_SAMPLE_COUNT];
+        for (int sample = 0; sample < ENGINE_BENCHMARK_SAMPLE_COUNT; ++sample)
+        {
+            long long op_count = 0;
+            Uint64 start = SDL_GetPerformanceCounter();
+            for (int pass = 0; pass < passes; ++pass)
+            {
+                op_count += run_engine_pass((enum Engine_Benchmark)benchmark, &corpus, game, &sink);
+            }
+            double ns = (double)(SDL_GetPerformanceCounter() - start) * 1e9 / frequency;
+            samples[sample] = op_count > 0 ? ns / op_count : 0;
+        }
+        qsort(samples, ENGINE_BENCHMARK_SAMPLE_COUNT, sizeof(double), compare_double);
+
+        ns_per_op[benchmark] = samples[0];
+        printf("  %-18s %9.2f ns/op  (median %9.2f)  %9.2f Mops/s\n",
+               ENGINE_BENCHMARK_NAMES[benchmark], samples[0], samples[ENGINE_BENCHMARK_SAMPLE_COUNT / 2],
+               samples[0] > 0 ? 1000.0 / samples[0] : 0.0);
+    }
+    printf("  (checksum %d)\n", sink);
+    free(game);
+    board_corpus_free(&corpus);
+
+    if (!thresholds_filename)
+    {
+        return 0;
+    }
+
+    FILE *file = fopen(thresholds_filename, "r");
+    if (!file)
+    {
+        printf("Failed to open thresholds: %s\n", thresholds_filename);
+        return 1;
+    }
+
+    bool passed = true;
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        char name[32];
+        double limit_ns = 0;
+        if (sscanf(line, " engine %31s %lf", name, &limit_ns) != 2)
+        {
+            continue;
+        }
+        for (int benchmark = 0; benchmark < ENGINE_BENCHMARK_COUNT; ++benchmark)
+        {
+            if (strcmp(name, ENGINE_BENCHMARK_NAMES[benchmark]) == 0 && ns_per_op[benchmark] > limit_ns)
+            {
+                printf("  %s %.2f ns/op is over the %.2f ns/op threshold\n", name, ns_per_op[benchmark], limit_ns);
+                passed = false;
+            }
+        }
+    }
+    fclose(file);
+
+    printf("engine bench: %s\n", passed ? "passed" : "FAILED");
+    return passed ? 0 : 1;
+}
+
+// Function to add a finished game to the score store
+// The replay id is the seed the game was dealt from, "--seed" with it deals
+// the same pieces again and replays the game together with a recorded input script.
+// - scores: the store, 0 when scores are not kept
+// - game: game that just ended
+// - player: name the score is kept under
+static void record_score(struct Score_Store *scores, const struct Game_State *game, const char *player)
+{
+    if (!scores)
+    {
+        return;
+    }
+
+    struct Score_Record record;
+    ZERO_STRUCT(record);
+    score_store_name(record.player, player);
+    record.points = (uint32_t)game->points;
+    record.lines = (uint32_t)game->line_count;
+    record.level = (uint32_t)game->level;
+    record.replay_id = game->game_seed;
+    record.timestamp = (uint64_t)time(0);
+    score_store_submit(scores, &record);
+}
+
+// Function to print the best scores overall and of one player
+static void print_high_scores(const struct Score_Store *scores, const char *player, int count)
+{
+    struct Score_Record best[SCORE_STORE_TOP_K];
+    for (int list = 0; list < 2; ++list)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        int found = score_store_top(scores, list == 0 ? 0 : player, best, count);
+        double us = (double)(SDL_GetPerformanceCounter() - start) * 1e6 / SDL_GetPerformanceFrequency();
+
+        printf("%s (%d found in %.1f us):\n", list == 0 ? "High scores" : player, found, us);
+        for (int i = 0; i < found; ++i)
+        {
+            char date[32];
+            time_t timestamp = (time_t)best[i].timestamp;
+            struct tm *local = localtime(&timestamp);
+            if (!local || !strftime(date, sizeof(date), "%Y-%m-%d %H:%M", local))
+            {
+                snprintf(date, sizeof(date), "-");
+            }
+            printf("  %2d. %-15s %8u points %4u lines level %2u  %s  replay %llu\n", i + 1, best[i].player,
+                   best[i].points, best[i].lines, best[i].level, date, (unsigned long long)best[i].replay_id);
+        }
+    }
+}
+
+// Function to pack a color for the terminal
+static uint32_t terminal_color(struct Color color)
+{
+    return (uint32_t)color.r << 16 | (uint32_t)color.g << 8 | color.b;
+}
+
+// Function to map a terminal key to the INPUT_KEY bit it controls, 0 for other keys
+static int map_terminal_key(int key)
+{
+    switch (key)
+    {
+    case TERMINAL_KEY_LEFT:
+        return INPUT_KEY_LEFT;
+    case TERMINAL_KEY_RIGHT:
+        return INPUT_KEY_RIGHT;
+    case TERMINAL_KEY_UP:
+        return INPUT_KEY_UP;
+    case TERMINAL_KEY_DOWN:
+        return INPUT_KEY_DOWN;
+    case ' ':
+        return INPUT_KEY_A;
+    default:
+        return 0;
+    }
+}
+
+// Function to find the first board row the terminal shows
+// Boards taller than the terminal view scroll to keep the falling piece in sight.
+static int terminal_view_top(const struct Game_State *game, int view_rows)
+{
+    int top = BOARD_HIDDEN_ROWS;
+    int last_top = game->board.height - view_rows;
+    if (last_top > top)
+    {
+        int piece_top = game->piece.offset_row - 2;
+        top = piece_top < top ? top : (piece_top > last_top ? last_top : piece_top);
+    }
+    return top;
+}
+
+// Function to render the game as terminal cells, each board cell two columns wide
+// - game: game state to draw
+// - terminal: terminal whose grid is drawn into
+// - view_rows: board rows that fit in the terminal
+// - status: line shown under the board
+static void render_game_terminal(const struct Game_State *game, struct Terminal *terminal, int view_rows, const char *status)
+{
+    TRACE_SCOPE("render_game_terminal");
+
+    char buffer[64];
+    uint32_t background = terminal_color(BASE_COLORS[0]);
+    uint32_t border = 0x808080;
+    uint32_t highlight = 0xFFFFFF;
+    int width = game->board.width;
+    int panel_col = width * 2 + 4;
+    int top = terminal_view_top(game, view_rows);
+
+    terminal_clear(terminal, 0x000000);
+
+    for (int row = 0; row < view_rows; ++row)
+    {
+        terminal_put(terminal, row, 0, '|', border, 0x000000);
+        terminal_put(terminal, row, width * 2 + 1, '|', border, 0x000000);
+        for (int col = 0; col < width; ++col)
+        {
+            bool line = game->phase == GAME_PHASE_LINE && game->lines[top + row];
+            uint32_t color = line ? highlight : terminal_color(BASE_COLORS[board_get(&game->board, top + row, col)]);
+            terminal_put(terminal, row, col * 2 + 1, ' ', color, color);
+            terminal_put(terminal, row, col * 2 + 2, ' ', color, color);
+        }
+    }
+    for (int col = 0; col < width * 2 + 2; ++col)
+    {
+        terminal_put(terminal, view_rows, col, col == 0 || col == width * 2 + 1 ? '+' : '-', border, 0x000000);
+    }
+
+    if (game->phase == GAME_PHASE_PLAY)
+    {
+        // Ghost first so the piece covers it where they overlap
+        struct Piece_State ghost = game->piece;
+        while (check_piece_valid(&ghost, &game->board))
+        {
+            ghost.offset_row++;
+        }
+        --ghost.offset_row;
+
+        const struct Tetrino *tetrino = TETRINOS + game->piece.tetrino_index;
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            const struct Piece_State *piece = pass == 0 ? &ghost : &game->piece;
+            for (int row = 0; row < tetrino->side; ++row)
+            {
+                for (int col = 0; col < tetrino->side; ++col)
+                {
+                    unsigned char value = tetrino_get(tetrino, row, col, piece->rotation);
+                    int view_row = piece->offset_row + row - top;
+                    int view_col = (piece->offset_col + col) * 2 + 1;
+                    if (!value || view_row < 0 || view_row >= view_rows)
+                    {
+                        continue;
+                    }
+
+                    uint32_t color = terminal_color(BASE_COLORS[value]);
+                    terminal_put(terminal, view_row, view_col, pass == 0 ? '[' : ' ', color, pass == 0 ? background : color);
+                    terminal_put(terminal, view_row, view_col + 1, pass == 0 ? ']' : ' ', color, pass == 0 ? background : color);
+                }
+            }
+        }
+    }
+
+    snprintf(buffer, sizeof(buffer), "LEVEL: %d", game->level);
+    terminal_text(terminal, 0, panel_col, buffer, highlight);
+    snprintf(buffer, sizeof(buffer), "LINES: %d", game->line_count);
+    terminal_text(terminal, 1, panel_col, buffer, highlight);
+    snprintf(buffer, sizeof(buffer), "POINTS: %d", game->points);
+    terminal_text(terminal, 2, panel_col, buffer, highlight);
+
+    if (game->phase == GAME_PHASE_PLAY || game->phase == GAME_PHASE_LINE)
+    {
+        terminal_text(terminal, 4, panel_col, "NEXT", highlight);
+        const struct Tetrino *next = TETRINOS + peek_next_piece(game, 0);
+        for (int row = 0; row < next->side; ++row)
+        {
+            for (int col = 0; col < next->side; ++col)
+            {
+                unsigned char value = tetrino_get(next, row, col, 0);
+                if (value)
+                {
+                    uint32_t color = terminal_color(BASE_COLORS[value]);
+                    terminal_put(terminal, 5 + row, panel_col + col * 2, ' ', color, color);
+                    terminal_put(terminal, 5 + row, panel_col + col * 2 + 1, ' ', color, color);
+                }
+            }
+        }
+    }
+
+    int center_col = width + 1;
+    int center_row = view_rows / 2;
+    if (game->paused)
+    {
+        terminal_text(terminal, center_row, center_col - 3, "PAUSED", highlight);
+    }
+    if (game->phase == GAME_PHASE_GAMEOVER)
+    {
+        terminal_text(terminal, center_row, center_col - 4, "GAME OVER", highlight);
+    }
+    else if (game->phase == GAME_PHASE_START)
+    {
+        terminal_text(terminal, center_row, center_col - 5, "PRESS START", highlight);
+        snprintf(buffer, sizeof(buffer), "STARTING LEVEL: %d", game->start_level);
+        terminal_text(terminal, center_row + 2, center_col - (int)strlen(buffer) / 2, buffer, highlight);
+    }
+
+    terminal_text(terminal, view_rows + 1, 0, status, border);
+}
+
+// Function to play the game in the terminal, without a window
+// Arrow keys move and rotate, space drops and starts, p pauses, q or escape quits.
+// Terminals report key repeats but no releases, so each key is a press and an
+// immediate release and sideways repeat follows the terminal's own key repeat.
+// - game: game state, board and rules set up
+// - randomizer_mode, seed: piece sequence to deal
+// - das_ms, arr_ms: auto-repeat timing of the input tracker
+// - target_fps: frames per second to draw at
+// - scores, player: store finished games are added to, 0 when scores are not kept
+// - returns the exit code
+static int run_terminal(struct Game_State *game, enum Randomizer_Mode randomizer_mode, uint64_t seed, int das_ms, int arr_ms, int target_fps,
+                        struct Score_Store *scores, const char *player)
+{
+    int view_rows = game->board.height - BOARD_HIDDEN_ROWS;
+    view_rows = view_rows < TERMINAL_MAX_BOARD_ROWS ? view_rows : TERMINAL_MAX_BOARD_ROWS;
+    int columns = game->board.width * 2 + 4 + TERMINAL_PANEL_COLUMNS;
+    columns = columns > TERMINAL_STATUS_COLUMNS ? columns : TERMINAL_STATUS_COLUMNS;
+
+    struct Terminal terminal;
+    if (!terminal_open(&terminal, columns, view_rows + 2))
+    {
+        terminal_close(&terminal);
+        return 1;
+    }
+
+    struct Input_Queue input_queue;
+    struct Input_Tracker input_tracker;
+    input_queue_init(&input_queue);
+    input_tracker_init(&input_tracker, das_ms, arr_ms);
+
+    struct Random rng;
+    random_seed(&rng, seed);
+    reset_piece_queue(game, randomizer_mode, &rng);
+    game->session_seed = seed;
+    spawn_piece(game);
+    game->time = SDL_GetTicks() / 1000.0;
+
+    struct Frame_Pacer pacer;
+    frame_pacer_init(&pacer, target_fps > 0 ? target_fps : 60);
+
+    // Bytes sent against what redrawing every cell would have sent, refreshed once a
+    // second so the status line itself adds next to nothing
+    char status[TERMINAL_STATUS_COLUMNS + 1] = "";
+    Uint32 status_time = SDL_GetTicks();
+    unsigned long long status_bytes = 0;
+    unsigned long long status_full_bytes = 0;
+    int status_frames = 0;
+
+    bool quit = false;
+    while (!quit)
+    {
+        Uint32 now = SDL_GetTicks();
+        if (now - status_time >= 1000 && terminal.frame_count > status_frames)
+        {
+            int frames = terminal.frame_count - status_frames;
+            snprintf(status, sizeof(status), "%llu B/frame sent, %llu B full redraw",
+                     (terminal.total_bytes - status_bytes) / frames, (terminal.total_full_bytes - status_full_bytes) / frames);
+            status_time = now;
+            status_bytes = terminal.total_bytes;
+            status_full_bytes = terminal.total_full_bytes;
+            status_frames = terminal.frame_count;
+        }
+
+        int key;
+        while ((key = terminal_read_key(&terminal)) != TERMINAL_KEY_NONE)
+        {
+            if (key == 'q' || key == TERMINAL_KEY_ESCAPE || key == 3)
+            {
+                quit = true;
+            }
+            else if (key == 'p')
+            {
+                game->paused = !game->paused;
+            }
+            else if (map_terminal_key(key))
+            {
+                struct Input_Event press = {now, map_terminal_key(key), true, SDL_GetPerformanceCounter()};
+                struct Input_Event release = press;
+                release.pressed = false;
+                if (!input_queue_push(&input_queue, &press) || !input_queue_push(&input_queue, &release))
+                {
+                    printf("Input queue full, key event dropped\n");
+                }
+            }
+        }
+
+        enum Game_Phase previous_phase = game->phase;
+        run_input(game, &input_tracker, &input_queue, now);
+        if (game->phase == GAME_PHASE_GAMEOVER && previous_phase != GAME_PHASE_GAMEOVER)
+        {
+            record_score(scores, game, player);
+        }
+
+        // There is no sound in the terminal
+        game->audio_events = 0;
+        game->input_polled_at = 0;
+
+        render_game_terminal(game, &terminal, view_rows, status);
+        terminal_present(&terminal);
+        frame_pacer_end_frame(&pacer);
+    }
+
+    terminal_close(&terminal);
+
+    int frames = terminal.frame_count > 0 ? terminal.frame_count : 1;
+    printf("terminal: %d frames, %.0f B/frame sent, %.0f B/frame for full redraws (%.1f%%)\n",
+           terminal.frame_count, (double)terminal.total_bytes / frames, (double)terminal.total_full_bytes / frames,
+           terminal.total_full_bytes > 0 ? 100.0 * terminal.total_bytes / terminal.total_full_bytes : 0.0);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // Counts allocations in builds with -DALLOC_TRACKING, must come before any other SDL call
+    alloc_tracker_install();
+    Uint64 startup_start = SDL_GetPerformanceCounter();
+
+    // Trace markers are recorded in builds with -DTRACING
+    trace_init();
+    trace_thread_name("main");
+
+    // Board size can be changed from the command line for tall variants
+    int board_width = BOARD_STANDARD_WIDTH;
+    int board_height = BOARD_STANDARD_HEIGHT;
+    const char *rules_name = "nes";
+    enum Randomizer_Mode randomizer_mode = RANDOMIZER_NES;
+    uint64_t seed = 0;
+    bool has_seed = false;
+    bool use_raster = false;
+    int raster_benchmark_frames = 0;
+    int target_fps = 60;
+    bool use_simulation_thread = false;
+    bool use_late_latch = false;
+    bool show_perf_hud = false;
+    const char *perf_dump_filename = 0;
+    const char *trace_filename = "trace.json";
+    const char *latency_filename = 0;
+    const char *bench_scenario_name = 0;
+    const char *bench_script_filename = 0;
+    const char *bench_thresholds_filename = 0;
+    const char *record_filename = 0;
+    const char *engine_bench_filename = 0;
+    const char *make_corpus_filename = 0;
+    bool use_terminal = false;
+    const char *scores_filename = "scores.log";
+    const char *player = getenv("USER") ? getenv("USER") : (getenv("USERNAME") ? getenv("USERNAME") : "player");
+    int high_score_count = 0;
+    int bench_frame_count = 600;
+    int das_ms = 167;
+    int arr_ms = 33;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--width") == 0)
+        {
+            board_width = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--height") == 0)
+        {
+            board_height = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--rules") == 0)
+        {
+            rules_name = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--randomizer") == 0)
+        {
+            randomizer_mode = strcmp(argv[i + 1], "bag") == 0 ? RANDOMIZER_BAG : RANDOMIZER_NES;
+        }
+        else if (strcmp(argv[i], "--seed") == 0)
+        {
+            seed = strtoull(argv[i + 1], 0, 10);
+            has_seed = true;
+        }
+        else if (strcmp(argv[i], "--backend") == 0)
+        {
+            use_raster = strcmp(argv[i + 1], "raster") == 0;
+        }
+        else if (strcmp(argv[i], "--sim-thread") == 0)
+        {
+            use_simulation_thread = atoi(argv[i + 1]) != 0;
+        }
+        else if (strcmp(argv[i], "--late-latch") == 0)
+        {
+            use_late_latch = atoi(argv[i + 1]) != 0;
+        }
+        else if (strcmp(argv[i], "--fps") == 0)
+        {
+            target_fps = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--perf-hud") == 0)
+        {
+            show_perf_hud = atoi(argv[i + 1]) != 0;
+        }
+        else if (strcmp(argv[i], "--perf-dump") == 0)
+        {
+            perf_dump_filename = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--trace") == 0)
+        {
+            trace_filename = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--das") == 0)
+        {
+            das_ms = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--arr") == 0)
+        {
+            arr_ms = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--latency") == 0)
+        {
+            latency_filename = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--bench") == 0)
+        {
+            bench_scenario_name = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--bench-frames") == 0)
+        {
+            bench_frame_count = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--bench-script") == 0)
+        {
+            bench_script_filename = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--bench-thresholds") == 0)
+        {
+            bench_thresholds_filename = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--record-input") == 0)
+        {
+            record_filename = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--bench-engine") == 0)
+        {
+            engine_bench_filename = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--make-corpus") == 0)
+        {
+            make_corpus_filename = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--frontend") == 0)
+        {
+            use_terminal = strcmp(argv[i + 1], "terminal") == 0;
+        }
+        else if (strcmp(argv[i], "--scores") == 0)
+        {
+            scores_filename = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--player") == 0)
+        {
+            player = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--high-scores") == 0)
+        {
+            high_score_count = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--bench-raster") == 0)
+        {
+            raster_benchmark_frames = atoi(argv[i + 1]);
+        }
+    }
+
+    // The frame benchmark runs the loop flat out on one thread with the software renderer
+    struct Frame_Bench *bench = 0;
+    if (bench_scenario_name)
+    {
+        enum Frame_Bench_Scenario scenario;
+        bench = (struct Frame_Bench *)malloc(sizeof(struct Frame_Bench));
+        if (!bench || !frame_bench_find_scenario(bench_scenario_name, &scenario) ||
+            !frame_bench_init(bench, scenario, bench_frame_count, bench_script_filename))
+        {
+            return 1;
+        }
+        use_simulation_thread = false;
+        use_late_latch = false;
+        target_fps = 0;
+    }
+
+    // "nes", "guideline" or the path of a custom ruleset file
+    struct Ruleset rules;
+    if (strcmp(rules_name, "nes") == 0)
+    {
+        ruleset_init_nes(&rules);
+    }
+    else if (strcmp(rules_name, "guideline") == 0)
+    {
+        ruleset_init_guideline(&rules);
+    }
+    else if (!ruleset_load(&rules, rules_name))
+    {
+        return 1;
+    }
+
+    // Engine microbenchmarks and their board corpus need no window
+    if (make_corpus_filename)
+    {
+        struct Board_Corpus corpus;
+        uint32_t corpus_seed = has_seed ? (uint32_t)seed : 1;
+        bool made = generate_board_corpus(&corpus, &rules, corpus_seed, board_width, board_height, BOARD_CORPUS_BOARDS_PER_CATEGORY) &&
+                    board_corpus_write(&corpus, make_corpus_filename);
+        board_corpus_free(&corpus);
+        return made ? 0 : 1;
+    }
+    if (engine_bench_filename)
+    {
+        return run_engine_benchmark(engine_bench_filename, &rules, bench_thresholds_filename);
+    }
+
+    struct Game_State game;
+    ZERO_STRUCT(game);
+    game.rules = &rules;
+    if (!board_init(&game.board, board_width, board_height))
+    {
+        printf("Invalid board size %dx%d\n", board_width, board_height);
+        return 1;
+    }
+
+    // Finished games are kept, except in benchmarks; "--scores none" turns it off
+    struct Score_Store score_store;
+    struct Score_Store *scores = 0;
+    if (!bench && strcmp(scores_filename, "none") != 0 && score_store_open(&score_store, scores_filename))
+    {
+        scores = &score_store;
+    }
+    if (high_score_count > 0)
+    {
+        if (scores)
+        {
+            print_high_scores(scores, player, high_score_count);
+            score_store_close(scores);
+        }
+        return scores ? 0 : 1;
+    }
+
+    // The terminal frontend shares the engine but opens no window
+    if (use_terminal)
+    {
+        int terminal_exit_code = run_terminal(&game, randomizer_mode, has_seed ? seed : SDL_GetPerformanceCounter(), das_ms, arr_ms, target_fps, scores, player);
+        if (scores)
+        {
+            score_store_close(scores);
+        }
+        return terminal_exit_code;
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+    {
+        return 1;
+    }
+
+    if (TTF_Init() < 0)
+    {
+        return 2;
+    }
+
+    SDL_Window *window = SDL_CreateWindow(
+        "Tetris",
+        SDL_WINDOWPOS_UNDEFINED,
+        SDL_WINDOWPOS_UNDEFINED,
+        board_width * GRID_SIZE,
+        board_height * GRID_SIZE + 60,
+        bench ? SDL_WINDOW_SHOWN : SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
+    if (!window)
+    {
+        printf("Failed to create window: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    // Benchmarks must not wait for vsync and must not depend on the GPU
+    SDL_Renderer *renderer = SDL_CreateRenderer(
+        window,
+        -1,
+        bench ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    if (!renderer)
+    {
+        // No GPU, fall back to SDL's software renderer
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+        if (!renderer)
+        {
+            printf("Failed to create renderer: %s\n", SDL_GetError());
+            return 1;
+        }
+    }
+
+    // Sound is only played from audio events raised by the engine, silently until it has loaded
+    struct Audio audio;
+    audio_init(&audio);
+
+    // Font and sounds load in the background while the first frames are drawn
+    struct Assets assets;
+    ZERO_STRUCT(assets);
+    assets.font_name = "November.ttf";
+    assets.audio = &audio;
+    assets.loaded_event = SDL_RegisterEvents(1);
+    assets.start = startup_start;
+    SDL_Thread *asset_thread = SDL_CreateThread(load_assets, "assets", &assets);
+    if (!asset_thread)
+    {
+        load_assets(&assets);
+    }
+    else if (bench)
+    {
+        // Every benchmark frame draws the text
+        SDL_WaitThread(asset_thread, 0);
+        asset_thread = 0;
+    }
+
+    // Text is drawn once the font has loaded and the atlas is built
+    struct Font_Atlas atlas;
+    struct Font_Atlas *text_atlas = 0;
+    ZERO_STRUCT(atlas);
+
+    // Three rectangles per cell covers a full standard board with room to spare
+    struct Render_Commands commands;
+    if (!render_commands_init(&commands, renderer, 1024))
+    {
+        return 1;
+    }
+
+    // The raster backend draws the whole frame itself and needs no board texture
+    struct Board_Cache board_cache;
+    struct Raster raster;
+    ZERO_STRUCT(board_cache);
+    ZERO_STRUCT(raster);
+    if (use_raster && raster_init(&raster, renderer, board_width * GRID_SIZE, board_height * GRID_SIZE + 60))
+    {
+        commands.raster = &raster;
+    }
+    else
+    {
+        board_cache_init(&board_cache, renderer, &game.board);
+    }
+
+    // Key presses and releases are applied in order at the time they happened
+    struct Input_Queue input_queue;
+    struct Input_Tracker input_tracker;
+    input_queue_init(&input_queue);
+    input_tracker_init(&input_tracker, das_ms, arr_ms);
+
+    // The same seed replays the same piece sequence
+    if (!has_seed)
+    {
+        seed = bench ? 1 : SDL_GetPerformanceCounter();
+    }
+    struct Random rng;
+    random_seed(&rng, seed);
+    reset_piece_queue(&game, randomizer_mode, &rng);
+    game.session_seed = seed;
+
+    spawn_piece(&game);
+
+    game.piece.tetrino_index = 2;
+
+    // Benchmark time advances one 60 Hz frame per loop, however long the frame took
+    Uint32 bench_start_ms = SDL_GetTicks();
+    bool bench_rows_filled = false;
+    if (bench)
+    {
+        game.time = bench_start_ms / 1000.0;
+        setup_bench_scenario(&game, bench->scenario);
+    }
+
+    // Key events can be recorded as an input script for the frame benchmark
+    FILE *record_file = 0;
+    Uint32 record_start_ms = 0;
+    if (record_filename)
+    {
+        record_file = fopen(record_filename, "w");
+        if (!record_file)
+        {
+            printf("Failed to open %s\n", record_filename);
+            return 1;
+        }
+    }
+
+    // Holds the frame rate when vsync is unavailable, e.g. on the dummy driver
+    struct Frame_Pacer pacer;
+    frame_pacer_init(&pacer, target_fps);
+    if (use_late_latch)
+    {
+        // Vsync follows the display the window is on, the target frame rate stands in when it is unknown
+        SDL_DisplayMode display_mode;
+        int refresh_rate = SDL_GetWindowDisplayMode(window, &display_mode) == 0 ? display_mode.refresh_rate : 0;
+        frame_pacer_enable_late_latch(&pacer, refresh_rate);
+    }
+
+    // F3 toggles the timing overlay
+    struct Perf_Hud perf_hud;
+    if (!perf_hud_init(&perf_hud, target_fps, perf_dump_filename))
+    {
+        return 1;
+    }
+    perf_hud.visible = show_perf_hud;
+
+    // Input-to-display latency is only measured when a report file is given
+    struct Latency_Probe latency_probe;
+    latency_probe_init(&latency_probe, latency_filename);
+
+    bool quit = false;
+    int exit_code = 0;
+
+    // Benchmark mode renders offscreen and exits without entering the game loop
+    if (raster_benchmark_frames > 0)
+    {
+        SDL_WaitThread(asset_thread, 0);
+        asset_thread = 0;
+
+        struct Game_State benchmark_game = game;
+        fill_benchmark_board(&benchmark_game, benchmark_game.board.height / 2);
+        exit_code = assets.font ? run_raster_benchmark(&benchmark_game, assets.font, raster_benchmark_frames) : 1;
+        quit = true;
+    }
+
+    // With a simulation thread the main thread only handles events and renders snapshots
+    const struct Game_State *view = &game;
+    SDL_Point piece_offset = {0, 0};
+    struct Simulation *simulation = 0;
+    SDL_Thread *simulation_thread = 0;
+    if (use_simulation_thread && !quit)
+    {
+        simulation = (struct Simulation *)calloc(1, sizeof(struct Simulation));
+        if (!simulation)
+        {
+            return 1;
+        }
+
+        game.time = SDL_GetTicks() / 1000.0;
+        simulation->game = game;
+        for (int i = 0; i < 3; ++i)
+        {
+            simulation->snapshot_slots[i].game = game;
+            simulation->snapshot_slots[i].previous_piece = game.piece;
+        }
+        triple_buffer_init(&simulation->snapshots, simulation->snapshot_slots + 0, simulation->snapshot_slots + 1, simulation->snapshot_slots + 2);
+        simulation->redraw_event = SDL_RegisterEvents(1);
+        simulation->audio = &audio;
+        simulation->input = input_tracker;
+        view = &((const struct Game_Snapshot *)triple_buffer_front(&simulation->snapshots))->game;
+
+        simulation_thread = SDL_CreateThread(run_simulation, "simulation", simulation);
+        if (!simulation_thread)
+        {
+            printf("Failed to start simulation thread: %s\n", SDL_GetError());
+            return 1;
+        }
+    }
+
+    bool needs_redraw = true;
+    bool window_visible = true;
+    int play_frame_count = 0;
+    while (!quit)
+    {
+        // Static screens sleep until input arrives instead of redrawing every frame
+        if (!bench && is_game_idle(view) && (!needs_redraw || !window_visible))
+        {
+            SDL_WaitEventTimeout(0, IDLE_WAIT_MS);
+            frame_pacer_resume(&pacer);
+        }
+
+        // With late latching this sleeps so input is polled as close to the next vsync as possible
+        frame_pacer_latch(&pacer);
+        perf_hud_begin_frame(&perf_hud);
+
+        enum Game_Phase previous_phase = view->phase;
+        bool previous_paused = view->paused;
+
+        SDL_Event e;
+        while (SDL_PollEvent(&e) != 0)
+        {
+            if (e.type == SDL_QUIT)
+            {
+                quit = true;
+            }
+            else if (e.type == SDL_WINDOWEVENT)
+            {
+                switch (e.window.event)
+                {
+                case SDL_WINDOWEVENT_HIDDEN:
+                case SDL_WINDOWEVENT_MINIMIZED:
+                    window_visible = false;
+                    break;
+                case SDL_WINDOWEVENT_SHOWN:
+                case SDL_WINDOWEVENT_RESTORED:
+                case SDL_WINDOWEVENT_MAXIMIZED:
+                case SDL_WINDOWEVENT_EXPOSED:
+                    window_visible = true;
+                    needs_redraw = true;
+                    break;
+                default:
+                    break;
+                }
+            }
+            else if (e.type == SDL_RENDER_TARGETS_RESET)
+            {
+                // Render target contents were lost, redraw every row
+                board_cache.valid = false;
+                needs_redraw = true;
+            }
+            else if ((e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) && !e.key.repeat && map_key(e.key.keysym.scancode))
+            {
+                // Auto-repeat is timed by the input tracker, the OS repeats are ignored
+                struct Input_Event event = {e.key.timestamp, map_key(e.key.keysym.scancode), e.type == SDL_KEYDOWN, SDL_GetPerformanceCounter()};
+                if (!input_queue_push(simulation ? &simulation->input_queue : &input_queue, &event))
+                {
+                    printf("Input queue full, key event dropped\n");
+                }
+                needs_redraw = true;
+
+                if (record_file)
+                {
+                    int key_index = 0;
+                    while ((1 << key_index) != event.key)
+                    {
+                        ++key_index;
+                    }
+                    record_start_ms = record_start_ms ? record_start_ms : event.timestamp;
+                    frame_bench_record_event(record_file, (int)((event.timestamp - record_start_ms) * 60 / 1000), key_index, event.pressed);
+                }
+            }
+            else if (e.type == SDL_KEYUP || e.type == assets.loaded_event || (simulation && e.type == simulation->redraw_event))
+            {
+                needs_redraw = true;
+            }
+            else if (e.type == SDL_KEYDOWN)
+            {
+                needs_redraw = true;
+                switch (e.key.keysym.sym)
+                {
+                case SDLK_ESCAPE:
+                    quit = true;
+                    break;
+                case SDLK_F3:
+                    perf_hud.visible = !perf_hud.visible;
+                    break;
+                case SDLK_p:
+                    if (simulation)
+                    {
+                        SDL_AtomicAdd(&simulation->pause_toggles, 1);
+                    }
+                    else
+                    {
+                        game.paused = !game.paused;
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+
+        // The font is needed to show anything beyond the board, quit if it could not be loaded
+        if (!text_atlas && SDL_AtomicGet(&assets.done))
+        {
+            if (!assets.font || !font_atlas_init(&atlas, renderer, assets.font))
+            {
+                printf("Failed to build font atlas: %s\n", SDL_GetError());
+                quit = true;
+                exit_code = 1;
+            }
+            else
+            {
+                text_atlas = &atlas;
+                printf("startup: assets loaded after %.1f ms, %u KB of decoded audio\n",
+                       assets.load_ms, assets.line_clear ? (unsigned)(assets.line_clear->alen / 1024) : 0);
+            }
+        }
+
+        // The benchmark script stands in for the keyboard
+        Uint32 bench_now = bench_start_ms;
+        if (bench)
+        {
+            bench_now = bench_start_ms + (Uint32)((Uint64)bench->frames_done * 1000 / 60);
+            update_bench_scenario(&game, bench, &bench_rows_filled);
+
+            struct Frame_Bench_Event script_events[16];
+            int script_event_count = frame_bench_script_events(bench, bench->frames_done, script_events, (int)ARRAY_COUNT(script_events));
+            for (int i = 0; i < script_event_count; ++i)
+            {
+                struct Input_Event event = {bench_now, 1 << script_events[i].key, script_events[i].pressed, SDL_GetPerformanceCounter()};
+                input_queue_push(&input_queue, &event);
+            }
+            needs_redraw = true;
+        }
+        perf_hud_mark(&perf_hud, PERF_PHASE_INPUT);
+
+        // With a simulation thread the update phase only picks up the latest snapshot
+        if (simulation)
+        {
+            triple_buffer_acquire(&simulation->snapshots);
+            const struct Game_Snapshot *snapshot = (const struct Game_Snapshot *)triple_buffer_front(&simulation->snapshots);
+            view = &snapshot->game;
+            piece_offset = interpolate_piece(snapshot);
+        }
+        else
+        {
+            // Update the game, applying the key events polled above at their own times
+            run_input(&game, &input_tracker, &input_queue, bench ? bench_now : SDL_GetTicks());
+            audio_play(&audio, game.audio_events);
+            game.audio_events = 0;
+        }
+        perf_hud_mark(&perf_hud, PERF_PHASE_UPDATE);
+
+        // Only queued here, the score store writes on its own thread
+        if (view->phase == GAME_PHASE_GAMEOVER && previous_phase != GAME_PHASE_GAMEOVER)
+        {
+            record_score(scores, view, player);
+        }
+
+        // Nothing is drawn while the window cannot be seen
+        bool idle = is_game_idle(view);
+        needs_redraw = needs_redraw || !idle || view->phase != previous_phase || view->paused != previous_paused || perf_hud.visible;
+        bool rendered = window_visible && needs_redraw;
+        if (rendered)
+        {
+            commands.draw_call_count = 0;
+            atlas.draw_call_count = 0;
+
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+            SDL_RenderClear(renderer);
+            render_game(view, piece_offset, &commands, &board_cache, text_atlas);
+            perf_hud_draw(&perf_hud, text_atlas, 6, 100, board_width * GRID_SIZE - 12);
+            perf_hud_mark(&perf_hud, PERF_PHASE_RENDER);
+
+            frame_pacer_submit(&pacer);
+            {
+                TRACE_SCOPE("SDL_RenderPresent");
+                SDL_RenderPresent(renderer);
+            }
+            perf_hud_mark(&perf_hud, PERF_PHASE_PRESENT);
+            latency_probe_record(&latency_probe, view->input_polled_at, SDL_GetPerformanceCounter());
+            game.input_polled_at = 0;
+            needs_redraw = false;
+
+            if (startup_start)
+            {
+                double startup_ms = (double)(SDL_GetPerformanceCounter() - startup_start) * 1000.0 / SDL_GetPerformanceFrequency();
+                printf("startup: first frame after %.1f ms%s\n", startup_ms, startup_ms > STARTUP_BUDGET_MS ? ", over budget" : "");
+                startup_start = 0;
+            }
+        }
+
+        if (!idle)
+        {
+            frame_pacer_end_frame(&pacer);
+        }
+        if (rendered || !idle)
+        {
+            perf_hud_end_frame(&perf_hud, commands.draw_call_count + atlas.draw_call_count);
+
+            // Steady state is the play phase once the first frames have grown every buffer
+            bool playing = view->phase == GAME_PHASE_PLAY && !view->paused;
+            play_frame_count += playing;
+            alloc_tracker_end_frame(playing && play_frame_count > ALLOC_TRACKER_WARMUP_FRAMES);
+            trace_frame_end();
+
+            if (bench && frame_bench_end_frame(bench, &perf_hud))
+            {
+                quit = true;
+            }
+        }
+    }
+
+    if (simulation)
+    {
+        SDL_AtomicSet(&simulation->quit, 1);
+        SDL_WaitThread(simulation_thread, 0);
+        free(simulation);
+    }
+
+    frame_pacer_report(&pacer, stdout);
+    if (bench)
+    {
+        if (!frame_bench_report(bench, bench_thresholds_filename, stdout))
+        {
+            exit_code = 1;
+        }
+        free(bench);
+    }
+    if (record_file)
+    {
+        fclose(record_file);
+    }
+    if (scores)
+    {
+        score_store_close(scores);
+    }
+    perf_hud_free(&perf_hud);
+    if (!alloc_tracker_report(stdout))
+    {
+        exit_code = 1;
+    }
+    // Loading cannot be cancelled, it is waited for before the assets and the
+    // trace buffers it records into are freed
+    SDL_WaitThread(asset_thread, 0);
+    trace_write(trace_filename);
+    trace_free();
+
+    // Rows from several runs end up in one file, labelled with what may change the latency
+    SDL_RendererInfo renderer_info;
+    char latency_backend[64];
+    char latency_mode[64];
+    snprintf(latency_backend, sizeof(latency_backend), "%s/%s",
+             commands.raster ? "raster" : "sdl", SDL_GetRendererInfo(renderer, &renderer_info) == 0 ? renderer_info.name : "unknown");
+    snprintf(latency_mode, sizeof(latency_mode), "%s%s",
+             use_simulation_thread ? "sim-thread" : "single-thread", use_late_latch ? "+late-latch" : "");
+    if (!latency_probe_report(&latency_probe, latency_mode, latency_backend, stdout))
+    {
+        exit_code = 1;
+    }
 
-    TTF_CloseFont(font);
+    raster_free(&raster);
+    board_cache_free(&board_cache);
+    render_commands_free(&commands);
+    font_atlas_free(&atlas);
     SDL_DestroyRenderer(renderer);
-    Mix_FreeChunk(clear_line_sound);
-    Mix_FreeChunk(game_over_sound);
-    Mix_FreeChunk(theme_sound);
-    Mix_CloseAudio();
+
+    if (assets.font)
+    {
+        TTF_CloseFont(assets.font);
+    }
+    if (assets.audio_open)
+    {
+        Mix_HaltMusic();
+        Mix_FreeChunk(assets.line_clear);
+        Mix_FreeMusic(assets.game_over);
+        Mix_FreeMusic(assets.theme);
+        Mix_CloseAudio();
+    }
+    asset_pack_close(&assets.pack);
     SDL_Quit();
 
-    return 0;
+    return exit_code;
 }
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Only the pack format and the reader are used, not SDL
+#define ASSET_PACK_NO_SDL
+#include "asset_pack.h"
+
+// Build step that packs the game's assets into one file for asset_pack.h.
+// Compile with "gcc -std=c11 pack_assets.c -o pack_assets" and run it from the
+// directory holding the assets:
+//   pack_assets assets.pack November.ttf sounds/clear.wav sounds/gameover.mp3 sounds/theme.mp3
+// Assets are stored under the names given on the command line. With
+// "--header assets_pack_data.h" before the output file the pack is also
+// written as a C array, which main.c links in when compiled with
+// -DASSET_PACK_EMBEDDED.
+
+static void write_u32(unsigned char *bytes, uint32_t value)
+{
+    bytes[0] = (unsigned char)value;
+    bytes[1] = (unsigned char)(value >> 8);
+    bytes[2] = (unsigned char)(value >> 16);
+    bytes[3] = (unsigned char)(value >> 24);
+}
+
+// Function to read a whole file into memory
+// - filename: file to read
+// - size: receives the size of the file
+// - returns the contents, to be freed by the caller, or 0 on failure
+static unsigned char *read_file(const char *filename, size_t *size)
+{
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+    {
+        return 0;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char *data = length >= 0 ? (unsigned char *)malloc(length > 0 ? length : 1) : 0;
+    if (data && fread(data, 1, length, file) != (size_t)length)
+    {
+        free(data);
+        data = 0;
+    }
+    fclose(file);
+
+    *size = (size_t)length;
+    return data;
+}
+
+// Function to write the pack as a C array
+static int write_header(const char *filename, const unsigned char *pack, size_t size)
+{
+    FILE *file = fopen(filename, "w");
+    if (!file)
+    {
+        printf("Failed to open %s\n", filename);
+        return 1;
+    }
+
+    fprintf(file, "// Generated by pack_assets, do not edit\n");
+    fprintf(file, "static const unsigned char ASSET_PACK_DATA[%zu] = {", size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        fprintf(file, "%s%u,", i % 24 == 0 ? "\n    " : "", pack[i]);
+    }
+    fprintf(file, "\n};\n");
+    fclose(file);
+    return 0;
+}
+
+// Function to append one asset to the pack
+// - pack, size: pack built so far, grown in place
+// - index: entry of the asset
+// - name: file to read, stored under the same name
+// - returns false if the asset could not be added
+static bool add_asset(unsigned char **pack, size_t *size, int index, const char *name)
+{
+    if (strlen(name) >= ASSET_PACK_NAME_SIZE)
+    {
+        printf("Asset name too long: %s\n", name);
+        return false;
+    }
+
+    size_t asset_size = 0;
+    unsigned char *asset = read_file(name, &asset_size);
+    if (!asset)
+    {
+        printf("Failed to read %s\n", name);
+        return false;
+    }
+
+    size_t offset = *size;
+    size_t grown_size = (offset + asset_size + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+    unsigned char *grown_pack = grown_size <= UINT32_MAX ? (unsigned char *)realloc(*pack, grown_size) : 0;
+    if (!grown_pack)
+    {
+        printf(grown_size > UINT32_MAX ? "Asset pack too large\n" : "Out of memory\n");
+        free(asset);
+        return false;
+    }
+    *pack = grown_pack;
+    memset(grown_pack + offset, 0, grown_size - offset);
+    memcpy(grown_pack + offset, asset, asset_size);
+    *size = grown_size;
+    free(asset);
+
+    unsigned char *entry = grown_pack + ASSET_PACK_HEADER_SIZE + index * ASSET_PACK_ENTRY_SIZE;
+    strcpy((char *)entry, name);
+    write_u32(entry + ASSET_PACK_NAME_SIZE, (uint32_t)offset);
+    write_u32(entry + ASSET_PACK_NAME_SIZE + 4, (uint32_t)asset_size);
+    printf("%-24s %10zu bytes at %zu\n", name, asset_size, offset);
+    return true;
+}
+
+// Function to check a written pack with the reader the game uses
+// - returns false if the game would reject the pack or find an asset in it
+static bool verify_pack(const char *pack_name, char **asset_names, int asset_count)
+{
+    struct Asset_Pack pack;
+    bool valid = asset_pack_open(&pack, pack_name) && pack.entry_count == (uint32_t)asset_count;
+    for (int i = 0; valid && i < asset_count; ++i)
+    {
+        size_t size = 0;
+        valid = asset_pack_find(&pack, asset_names[i], &size) != 0;
+    }
+    asset_pack_close(&pack);
+    if (!valid)
+    {
+        printf("%s does not read back as written\n", pack_name);
+    }
+    return valid;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *header_name = 0;
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "--header") == 0)
+    {
+        header_name = argv[2];
+        first = 3;
+    }
+    if (argc - first < 2)
+    {
+        printf("usage: pack_assets [--header pack_data.h] output.pack asset...\n");
+        return 1;
+    }
+
+    const char *pack_name = argv[first];
+    char **asset_names = argv + first + 1;
+    int asset_count = argc - first - 1;
+
+    // Index first, contents are appended as they are read
+    size_t size = ASSET_PACK_HEADER_SIZE + (size_t)asset_count * ASSET_PACK_ENTRY_SIZE;
+    size = (size + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+    unsigned char *pack = (unsigned char *)calloc(1, size);
+    bool valid = pack != 0;
+    if (valid)
+    {
+        memcpy(pack, ASSET_PACK_MAGIC, 4);
+        write_u32(pack + 4, ASSET_PACK_VERSION);
+        write_u32(pack + 8, (uint32_t)asset_count);
+    }
+
+    for (int i = 0; valid && i < asset_count; ++i)
+    {
+        valid = add_asset(&pack, &size, i, asset_names[i]);
+    }
+
+    if (valid)
+    {
+        FILE *file = fopen(pack_name, "wb");
+        valid = file && fwrite(pack, 1, size, file) == size;
+        valid = file && fclose(file) == 0 && valid;
+        if (!valid)
+        {
+            printf("Failed to write %s\n", pack_name);
+        }
+    }
+
+    valid = valid && verify_pack(pack_name, asset_names, asset_count);
+    if (valid)
+    {
+        printf("%s: %d assets, %zu bytes\n", pack_name, asset_count, size);
+    }
+
+    valid = valid && (!header_name || write_header(header_name, pack, size) == 0);
+    free(pack);
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+#ifndef PERF_HUD_H
+#define PERF_HUD_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "include/SDL2/SDL.h"
+
+#include "font_atlas.h"
+#include "render_commands.h"
+
+// Per-frame timing overlay.
+// The main loop marks the end of each phase of a frame (input, update, render,
+// present); the HUD keeps the last PERF_HUD_HISTORY_COUNT frames and shows
+// rolling p50/p99/max per phase, the dropped frame count, the draw calls of the
+// last frame and a bar graph of recent frame times. Every frame can also be
+// written to a CSV or JSON file for offline analysis.
+
+#define PERF_HUD_HISTORY_COUNT 240
+
+enum Perf_Phase
+{
+    PERF_PHASE_INPUT,
+    PERF_PHASE_UPDATE,
+    PERF_PHASE_RENDER,
+    PERF_PHASE_PRESENT,
+
+    // Whole frame including the frame pacer's wait
+    PERF_PHASE_FRAME,
+
+    PERF_PHASE_COUNT
+};
+
+static const char *PERF_PHASE_NAMES[PERF_PHASE_COUNT] = {"INPUT", "UPDATE", "RENDER", "PRESENT", "FRAME"};
+
+struct Perf_Hud
+{
+    Uint64 frequency;
+    double target_ms;
+
+    Uint64 frame_start;
+    Uint64 phase_start;
+    float current_ms[PERF_PHASE_COUNT];
+
+    float history_ms[PERF_PHASE_COUNT][PERF_HUD_HISTORY_COUNT];
+    bool history_dropped[PERF_HUD_HISTORY_COUNT];
+    int history_count;
+    int history_head;
+
+    int frame_count;
+    int dropped_frame_count;
+    int draw_call_count;
+
+    bool visible;
+
+    // Frame time graph, one quad per bar drawn in a single call
+    SDL_Vertex bar_vertices[PERF_HUD_HISTORY_COUNT * 4];
+    int bar_indices[PERF_HUD_HISTORY_COUNT * 6];
+
+    // Optional per-frame dump, CSV unless the file name ends in ".json"
+    FILE *dump;
+    bool dump_json;
+};
+
+// Function to set up the HUD
+// - hud: HUD to initialize
+// - target_fps: frame rate a frame is measured against, frames taking over 1.5 intervals count as dropped
+// - dump_filename: file to write every frame to, or 0
+// - returns false if the dump file could not be opened
+static bool perf_hud_init(struct Perf_Hud *hud, int target_fps, const char *dump_filename)
+{
+    memset(hud, 0, sizeof(*hud));
+    hud->frequency = SDL_GetPerformanceFrequency();
+    hud->target_ms = target_fps > 0 ? 1000.0 / target_fps : 1000.0 / 60.0;
+    render_commands_write_indices(hud->bar_indices, 0, PERF_HUD_HISTORY_COUNT);
+    if (!dump_filename)
+    {
+        return true;
+    }
+
+    hud->dump = fopen(dump_filename, "w");
+    if (!hud->dump)
+    {
+        printf("Failed to open %s\n", dump_filename);
+        return false;
+    }
+
+    size_t length = strlen(dump_filename);
+    hud->dump_json = length >= 5 && strcmp(dump_filename + length - 5, ".json") == 0;
+    if (hud->dump_json)
+    {
+        fprintf(hud->dump, "[\n");
+    }
+    else
+    {
+        fprintf(hud->dump, "frame,input_ms,update_ms,render_ms,present_ms,frame_ms,draw_calls,dropped\n");
+    }
+    return true;
+}
+
+// Function to finish the dump file
+static void perf_hud_free(struct Perf_Hud *hud)
+{
+    if (hud->dump)
+    {
+        if (hud->dump_json)
+        {
+            fprintf(hud->dump, "\n]\n");
+        }
+        fclose(hud->dump);
+    }
+    memset(hud, 0, sizeof(*hud));
+}
+
+static float perf_hud_elapsed_ms(const struct Perf_Hud *hud, Uint64 start, Uint64 end)
+{
+    return (float)((double)(end - start) * 1000.0 / hud->frequency);
+}
+
+// Function to start timing a frame, call it after any deliberate blocking
+static void perf_hud_begin_frame(struct Perf_Hud *hud)
+{
+    hud->frame_start = SDL_GetPerformanceCounter();
+    hud->phase_start = hud->frame_start;
+    memset(hud->current_ms, 0, sizeof(hud->current_ms));
+}
+
+// Function to end the running phase, the next phase starts now
+static void perf_hud_mark(struct Perf_Hud *hud, enum Perf_Phase phase)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    hud->current_ms[phase] += perf_hud_elapsed_ms(hud, hud->phase_start, now);
+    hud->phase_start = now;
+}
+
+// Function to record the frame, call it after the frame pacer returns
+// - hud: the HUD
+// - draw_call_count: SDL draw calls issued by the frame
+static void perf_hud_end_frame(struct Perf_Hud *hud, int draw_call_count)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    hud->current_ms[PERF_PHASE_FRAME] = perf_hud_elapsed_ms(hud, hud->frame_start, now);
+
+    bool dropped = hud->current_ms[PERF_PHASE_FRAME] > hud->target_ms * 1.5;
+    hud->dropped_frame_count += dropped;
+    hud->draw_call_count = draw_call_count;
+
+    for (int phase = 0; phase < PERF_PHASE_COUNT; ++phase)
+    {
+        hud->history_ms[phase][hud->history_head] = hud->current_ms[phase];
+    }
+    hud->history_dropped[hud->history_head] = dropped;
+    hud->history_head = (hud->history_head + 1) % PERF_HUD_HISTORY_COUNT;
+    if (hud->history_count < PERF_HUD_HISTORY_COUNT)
+    {
+        ++hud->history_count;
+    }
+
+    if (hud->dump)
+    {
+        const float *ms = hud->current_ms;
+        if (hud->dump_json)
+        {
+            fprintf(hud->dump, "%s  {\"frame\": %d, \"input_ms\": %.4f, \"update_ms\": %.4f, \"render_ms\": %.4f, \"present_ms\": %.4f, \"frame_ms\": %.4f, \"draw_calls\": %d, \"dropped\": %s}",
+                    hud->frame_count > 0 ? ",\n" : "",
+                    hud->frame_count, ms[0], ms[1], ms[2], ms[3], ms[4], draw_call_count, dropped ? "true" : "false");
+        }
+        else
+        {
+            fprintf(hud->dump, "%d,%.4f,%.4f,%.4f,%.4f,%.4f,%d,%d\n",
+                    hud->frame_count, ms[0], ms[1], ms[2], ms[3], ms[4], draw_call_count, dropped);
+        }
+    }
+    ++hud->frame_count;
+}
+
+static int perf_hud_compare_float(const void *a, const void *b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+// Function to draw the HUD on top of the frame
+// - hud: the HUD, nothing is drawn unless it is visible
+// - atlas: glyph atlas used for rendering text, 0 while the font is loading
+// - x, y: top-left corner of the HUD
+// - width: width of the frame time graph in pixels
+static void perf_hud_draw(struct Perf_Hud *hud, struct Font_Atlas *atlas, int x, int y, int width)
+{
+    if (!hud->visible || hud->history_count == 0 || !atlas)
+    {
+        return;
+    }
+
+    SDL_Color text_color = {0xFF, 0xFF, 0x80, 0xFF};
+    int line_height = TTF_FontLineSkip(atlas->font);
+    char buffer[128];
+
+    font_atlas_draw(atlas, "MS P50/P99/MAX", x, y, text_color);
+    y += line_height;
+
+    int count = hud->history_count;
+    float sorted[PERF_HUD_HISTORY_COUNT];
+    for (int phase = 0; phase < PERF_PHASE_COUNT; ++phase)
+    {
+        memcpy(sorted, hud->history_ms[phase], sizeof(float) * count);
+        qsort(sorted, count, sizeof(float), perf_hud_compare_float);
+        snprintf(buffer, sizeof(buffer), "%s %.2f/%.2f/%.2f",
+                 PERF_PHASE_NAMES[phase], sorted[count * 50 / 100], sorted[count * 99 / 100], sorted[count - 1]);
+        font_atlas_draw(atlas, buffer, x, y, text_color);
+        y += line_height;
+    }
+
+    snprintf(buffer, sizeof(buffer), "DROPPED %d/%d", hud->dropped_frame_count, hud->frame_count);
+    font_atlas_draw(atlas, buffer, x, y, text_color);
+    y += line_height;
+
+    snprintf(buffer, sizeof(buffer), "DRAW CALLS %d", hud->draw_call_count);
+    font_atlas_draw(atlas, buffer, x, y, text_color);
+    y += line_height;
+
+    // One bar per frame, oldest on the left, scaled so two target intervals fill the graph
+    int graph_height = 60;
+    // Drawn as geometry, SDL_RenderFillRects would copy this many bars through the heap
+    int bar_count = count < width ? count : width;
+    SDL_Color normal_color = {0x44, 0xE5, 0x7A, 0xFF};
+    SDL_Color dropped_color = {0xE5, 0x44, 0x44, 0xFF};
+    for (int i = 0; i < bar_count; ++i)
+    {
+        int index = (hud->history_head - bar_count + i + PERF_HUD_HISTORY_COUNT) % PERF_HUD_HISTORY_COUNT;
+        int bar_height = (int)(hud->history_ms[PERF_PHASE_FRAME][index] / (hud->target_ms * 2) * graph_height);
+        bar_height = bar_height < 1 ? 1 : (bar_height > graph_height ? graph_height : bar_height);
+
+        SDL_Color color = hud->history_dropped[index] ? dropped_color : normal_color;
+        float x0 = (float)(x + i);
+        float y0 = (float)(y + graph_height - bar_height);
+        float x1 = x0 + 1;
+        float y1 = (float)(y + graph_height);
+
+        SDL_Vertex *quad = hud->bar_vertices + i * 4;
+        quad[0] = (SDL_Vertex){{x0, y0}, color, {0, 0}};
+        quad[1] = (SDL_Vertex){{x1, y0}, color, {0, 0}};
+        quad[2] = (SDL_Vertex){{x1, y1}, color, {0, 0}};
+        quad[3] = (SDL_Vertex){{x0, y1}, color, {0, 0}};
+    }
+
+    if (bar_count > 0)
+    {
+        SDL_RenderGeometry(atlas->renderer, 0, hud->bar_vertices, bar_count * 4, hud->bar_indices, bar_count * 6);
+    }
+
+    // Target frame time
+    SDL_SetRenderDrawColor(atlas->renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+    SDL_RenderDrawLine(atlas->renderer, x, y + graph_height / 2, x + bar_count - 1, y + graph_height / 2);
+}
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Seedable xoshiro256** generator.
+// Every game owns its own generator, so the sequence depends only on the seed
+// and not on the C library or on other games running in the same process.
+// random_jump advances a generator by 2^128 steps, which splits one seed into
+// independent streams for simulators running in parallel.
+
+struct Random
+{
+    uint64_t state[4];
+};
+
+static uint64_t random_rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t random_splitmix(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Function to seed a generator, any seed (including 0) gives a valid state
+static void random_seed(struct Random *rng, uint64_t seed)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        rng->state[i] = random_splitmix(&seed);
+    }
+}
+
+static uint64_t random_next(struct Random *rng)
+{
+    uint64_t *s = rng->state;
+    uint64_t result = random_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = random_rotl(s[3], 45);
+
+    return result;
+}
+
+// Function to pick an unbiased number in [0, range)
+// Uses a multiply-shift with rejection instead of the biased modulo.
+static uint32_t random_below(struct Random *rng, uint32_t range)
+{
+    uint64_t product = (random_next(rng) >> 32) * range;
+    uint32_t low = (uint32_t)product;
+    if (low < range)
+    {
+        uint32_t threshold = (uint32_t)(-range) % range;
+        while (low < threshold)
+        {
+            product = (random_next(rng) >> 32) * range;
+            low = (uint32_t)product;
+        }
+    }
+    return (uint32_t)(product >> 32);
+}
+
+// Function to advance the generator by 2^128 calls to random_next
+static void random_jump(struct Random *rng)
+{
+    static const uint64_t JUMP[] = {0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull, 0xA9582618E03FC9AAull, 0x39ABDC4529B1661Cull};
+
+    uint64_t state[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int bit = 0; bit < 64; ++bit)
+        {
+            if (JUMP[i] & (1ull << bit))
+            {
+                state[0] ^= rng->state[0];
+                state[1] ^= rng->state[1];
+                state[2] ^= rng->state[2];
+                state[3] ^= rng->state[3];
+            }
+            random_next(rng);
+        }
+    }
+    memcpy(rng->state, state, sizeof(state));
+}
+
+// Function to seed the generator of one of several parallel streams
+// - rng: generator to seed
+// - seed: seed shared by all streams
+// - stream: index of the stream, streams never overlap for 2^128 draws
+static void random_seed_stream(struct Random *rng, uint64_t seed, unsigned int stream)
+{
+    random_seed(rng, seed);
+    for (unsigned int i = 0; i < stream; ++i)
+    {
+        random_jump(rng);
+    }
+}
+
+// Piece randomizers on top of the generator
+
+#define RANDOMIZER_PIECE_COUNT 7
+
+enum Randomizer_Mode
+{
+    RANDOMIZER_BAG,
+    RANDOMIZER_NES
+};
+
+struct Randomizer
+{
+    enum Randomizer_Mode mode;
+    struct Random rng;
+
+    unsigned char bag[RANDOMIZER_PIECE_COUNT];
+    int bag_count;
+
+    unsigned char previous;
+};
+
+static void randomizer_init(struct Randomizer *randomizer, enum Randomizer_Mode mode, const struct Random *rng)
+{
+    memset(randomizer, 0, sizeof(*randomizer));
+    randomizer->mode = mode;
+    randomizer->rng = *rng;
+    randomizer->previous = RANDOMIZER_PIECE_COUNT;
+}
+
+// Function to draw the next piece index in [0, RANDOMIZER_PIECE_COUNT)
+// - RANDOMIZER_BAG deals all seven pieces in a shuffled order, then reshuffles
+// - RANDOMIZER_NES rolls eight sides and rerolls once on a repeat or the dummy side
+static unsigned char randomizer_next(struct Randomizer *randomizer)
+{
+    unsigned char piece;
+    if (randomizer->mode == RANDOMIZER_BAG)
+    {
+        if (randomizer->bag_count == 0)
+        {
+            for (int i = 0; i < RANDOMIZER_PIECE_COUNT; ++i)
+            {
+                randomizer->bag[i] = (unsigned char)i;
+            }
+            for (int i = RANDOMIZER_PIECE_COUNT - 1; i > 0; --i)
+            {
+                int j = (int)random_below(&randomizer->rng, (uint32_t)(i + 1));
+                unsigned char swap = randomizer->bag[i];
+                randomizer->bag[i] = randomizer->bag[j];
+                randomizer->bag[j] = swap;
+            }
+            randomizer->bag_count = RANDOMIZER_PIECE_COUNT;
+        }
+        piece = randomizer->bag[--randomizer->bag_count];
+    }
+    else
+    {
+        piece = (unsigned char)random_below(&randomizer->rng, RANDOMIZER_PIECE_COUNT + 1);
+        if (piece == RANDOMIZER_PIECE_COUNT || piece == randomizer->previous)
+        {
+            piece = (unsigned char)random_below(&randomizer->rng, RANDOMIZER_PIECE_COUNT);
+        }
+    }
+
+    randomizer->previous = piece;
+    return piece;
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "include/SDL2/SDL.h"
+
+// Software rasterizer for solid rectangles.
+// The frame is drawn straight into the pixels of a locked streaming texture
+// with SIMD span fills and copied to the screen with a single SDL_RenderCopy.
+// On machines without a GPU this replaces hundreds of SDL_RenderFillRect calls
+// into SDL's software renderer. Rectangles follow SDL's rules (fills cover
+// [x, x + w) x [y, y + h), outlines are the one pixel border of that area),
+// so the output matches the SDL_Renderer path pixel for pixel.
+
+struct Raster
+{
+    SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    int width;
+    int height;
+
+    // Valid between raster_begin and raster_end
+    uint32_t *pixels;
+    int pitch;
+};
+
+static bool raster_init(struct Raster *raster, SDL_Renderer *renderer, int width, int height)
+{
+    memset(raster, 0, sizeof(*raster));
+    raster->renderer = renderer;
+    raster->width = width;
+    raster->height = height;
+    raster->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (!raster->texture)
+    {
+        return false;
+    }
+
+    // The frame replaces whatever is on screen, alpha is ignored
+    SDL_SetTextureBlendMode(raster->texture, SDL_BLENDMODE_NONE);
+    return true;
+}
+
+static void raster_free(struct Raster *raster)
+{
+    SDL_DestroyTexture(raster->texture);
+    memset(raster, 0, sizeof(*raster));
+}
+
+static uint32_t raster_color(SDL_Color color)
+{
+    return ((uint32_t)color.a << 24) | ((uint32_t)color.r << 16) | ((uint32_t)color.g << 8) | color.b;
+}
+
+// Function to fill `count` pixels starting at `dst` with one value
+static void raster_fill_span(uint32_t *dst, int count, uint32_t value)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    __m256i wide = _mm256_set1_epi32((int)value);
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_si256((__m256i *)(dst + i), wide);
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i narrow = _mm_set1_epi32((int)value);
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm_storeu_si128((__m128i *)(dst + i), narrow);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        dst[i] = value;
+    }
+}
+
+// Function to fill a rectangle, clipped to the frame
+static void raster_fill_rect(struct Raster *raster, const SDL_Rect *rect, uint32_t value)
+{
+    int x0 = rect->x < 0 ? 0 : rect->x;
+    int y0 = rect->y < 0 ? 0 : rect->y;
+    int x1 = rect->x + rect->w > raster->width ? raster->width : rect->x + rect->w;
+    int y1 = rect->y + rect->h > raster->height ? raster->height : rect->y + rect->h;
+    if (x0 >= x1 || y0 >= y1)
+    {
+        return;
+    }
+
+    uint32_t *row = raster->pixels + y0 * raster->pitch + x0;
+    for (int y = y0; y < y1; ++y, row += raster->pitch)
+    {
+        raster_fill_span(row, x1 - x0, value);
+    }
+}
+
+// Function to draw the one pixel border of a rectangle, clipped to the frame
+static void raster_draw_rect(struct Raster *raster, const SDL_Rect *rect, uint32_t value)
+{
+    if (rect->w <= 0 || rect->h <= 0)
+    {
+        return;
+    }
+
+    SDL_Rect top = {rect->x, rect->y, rect->w, 1};
+    SDL_Rect bottom = {rect->x, rect->y + rect->h - 1, rect->w, 1};
+    SDL_Rect left = {rect->x, rect->y, 1, rect->h};
+    SDL_Rect right = {rect->x + rect->w - 1, rect->y, 1, rect->h};
+    raster_fill_rect(raster, &top, value);
+    raster_fill_rect(raster, &bottom, value);
+    raster_fill_rect(raster, &left, value);
+    raster_fill_rect(raster, &right, value);
+}
+
+// Function to lock the frame texture and clear it to a color
+// - returns false if the texture could not be locked, nothing is drawn then
+static bool raster_begin(struct Raster *raster, SDL_Color clear_color)
+{
+    void *pixels = 0;
+    int pitch = 0;
+    if (SDL_LockTexture(raster->texture, 0, &pixels, &pitch) < 0)
+    {
+        raster->pixels = 0;
+        return false;
+    }
+
+    raster->pixels = (uint32_t *)pixels;
+    raster->pitch = pitch / (int)sizeof(uint32_t);
+
+    SDL_Rect frame = {0, 0, raster->width, raster->height};
+    raster_fill_rect(raster, &frame, raster_color(clear_color));
+    return true;
+}
+
+// Function to upload the frame and draw it over the whole render target
+static void raster_end(struct Raster *raster)
+{
+    if (!raster->pixels)
+    {
+        return;
+    }
+
+    SDL_UnlockTexture(raster->texture);
+    raster->pixels = 0;
+    SDL_RenderCopy(raster->renderer, raster->texture, 0, 0);
+}
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef RENDER_COMMANDS_H
+#define RENDER_COMMANDS_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "include/SDL2/SDL.h"
+
+#include "raster.h"
+
+// Frame command buffer for solid rectangles.
+// Drawing code pushes rectangles tagged with a pass, a layer and a color;
+// submitting sorts them by that key and draws them in key order. Filled
+// rectangles become colored quads in a vertex buffer and every run of fills
+// between two outline runs is one SDL_RenderGeometry call; outlines are one
+// SDL_RenderDrawRects call per run of equal keys. Rectangles that share a pass
+// and layer must not overlap unless they have the same color, which holds for
+// board cells: the dark, light and base parts of a cell are separate layers
+// and cells never overlap each other.
+// When a software raster is attached, the same commands are rasterized into
+// its streaming texture instead and the frame is uploaded once on submit.
+// Once the buffers have grown to the largest frame, recording and submitting
+// a frame allocates nothing. SDL_RenderFillRects is not used because it
+// converts rectangle arrays over 128 bytes through the heap on every call.
+
+enum Render_Pass
+{
+    RENDER_PASS_BOARD,
+    RENDER_PASS_OVERLAY
+};
+
+enum Render_Layer
+{
+    RENDER_LAYER_BACKGROUND,
+    RENDER_LAYER_CELL_DARK,
+    RENDER_LAYER_CELL_LIGHT,
+    RENDER_LAYER_CELL_BASE,
+    RENDER_LAYER_OUTLINE,
+    RENDER_LAYER_HIGHLIGHT
+};
+
+struct Render_Command
+{
+    uint64_t key;
+    SDL_Rect rect;
+};
+
+struct Render_Commands
+{
+    SDL_Renderer *renderer;
+    struct Raster *raster;
+    enum Render_Pass pass;
+
+    struct Render_Command *commands;
+    struct Render_Command *scratch;
+    SDL_Rect *rects;
+
+    // Four vertices per filled rectangle, the indices are written once
+    SDL_Vertex *vertices;
+    int *indices;
+
+    int count;
+    int capacity;
+
+    // Number of SDL draw calls issued since the caller last reset it
+    int draw_call_count;
+};
+
+// Writes the two triangles of every quad from `first` up to `last`
+static void render_commands_write_indices(int *indices, int first, int last)
+{
+    for (int quad = first; quad < last; ++quad)
+    {
+        int *quad_indices = indices + quad * 6;
+        int base = quad * 4;
+        quad_indices[0] = base;
+        quad_indices[1] = base + 1;
+        quad_indices[2] = base + 2;
+        quad_indices[3] = base;
+        quad_indices[4] = base + 2;
+        quad_indices[5] = base + 3;
+    }
+}
+
+static bool render_commands_init(struct Render_Commands *commands, SDL_Renderer *renderer, int capacity)
+{
+    memset(commands, 0, sizeof(*commands));
+    commands->renderer = renderer;
+    commands->capacity = capacity;
+    commands->commands = (struct Render_Command *)malloc(sizeof(struct Render_Command) * capacity);
+    commands->scratch = (struct Render_Command *)malloc(sizeof(struct Render_Command) * capacity);
+    commands->rects = (SDL_Rect *)malloc(sizeof(SDL_Rect) * capacity);
+    commands->vertices = (SDL_Vertex *)malloc(sizeof(SDL_Vertex) * 4 * capacity);
+    commands->indices = (int *)malloc(sizeof(int) * 6 * capacity);
+    if (!commands->commands || !commands->scratch || !commands->rects || !commands->vertices || !commands->indices)
+    {
+        return false;
+    }
+
+    render_commands_write_indices(commands->indices, 0, capacity);
+    return true;
+}
+
+static void render_commands_free(struct Render_Commands *commands)
+{
+    free(commands->commands);
+    free(commands->scratch);
+    free(commands->rects);
+    free(commands->vertices);
+    free(commands->indices);
+    memset(commands, 0, sizeof(*commands));
+}
+
+// Function to start recording a new frame
+static void render_commands_begin(struct Render_Commands *commands)
+{
+    commands->count = 0;
+    commands->pass = RENDER_PASS_BOARD;
+    if (commands->raster)
+    {
+        SDL_Color black = {0x00, 0x00, 0x00, 0x00};
+        raster_begin(commands->raster, black);
+    }
+}
+
+// Function to record one rectangle
+// - commands: command buffer to record into
+// - layer: layer inside the current pass, higher layers are drawn on top
+// - outline: true to draw the outline of the rectangle instead of filling it
+// - color: color of the rectangle
+// - rect: the rectangle
+static void render_commands_push(struct Render_Commands *commands, enum Render_Layer layer, bool outline, SDL_Color color, const SDL_Rect *rect)
+{
+    if (commands->count == commands->capacity)
+    {
+        // Grows during the first frames only, the capacity is kept afterwards
+        int capacity = commands->capacity * 2;
+        struct Render_Command *grown_commands = (struct Render_Command *)realloc(commands->commands, sizeof(struct Render_Command) * capacity);
+        if (!grown_commands)
+        {
+            return;
+        }
+        commands->commands = grown_commands;
+
+        struct Render_Command *grown_scratch = (struct Render_Command *)realloc(commands->scratch, sizeof(struct Render_Command) * capacity);
+        if (!grown_scratch)
+        {
+            return;
+        }
+        commands->scratch = grown_scratch;
+
+        SDL_Rect *grown_rects = (SDL_Rect *)realloc(commands->rects, sizeof(SDL_Rect) * capacity);
+        if (!grown_rects)
+        {
+            return;
+        }
+        commands->rects = grown_rects;
+
+        SDL_Vertex *grown_vertices = (SDL_Vertex *)realloc(commands->vertices, sizeof(SDL_Vertex) * 4 * capacity);
+        if (!grown_vertices)
+        {
+            return;
+        }
+        commands->vertices = grown_vertices;
+
+        int *grown_indices = (int *)realloc(commands->indices, sizeof(int) * 6 * capacity);
+        if (!grown_indices)
+        {
+            return;
+        }
+        commands->indices = grown_indices;
+        render_commands_write_indices(commands->indices, commands->capacity, capacity);
+        commands->capacity = capacity;
+    }
+
+    uint32_t order = ((uint32_t)commands->pass << 8) | ((uint32_t)layer << 1) | (outline ? 1u : 0u);
+    uint32_t rgba = ((uint32_t)color.r << 24) | ((uint32_t)color.g << 16) | ((uint32_t)color.b << 8) | color.a;
+
+    struct Render_Command *command = commands->commands + commands->count++;
+    command->key = ((uint64_t)order << 32) | rgba;
+    command->rect = *rect;
+}
+
+// Function to sort the recorded commands by key
+// Bottom-up merge sort through the scratch buffer; unlike qsort it never
+// allocates, and equal keys keep the order they were pushed in.
+static void render_commands_sort(struct Render_Commands *commands)
+{
+    struct Render_Command *source = commands->commands;
+    struct Render_Command *target = commands->scratch;
+    int count = commands->count;
+    for (int width = 1; width < count; width *= 2)
+    {
+        for (int start = 0; start < count; start += width * 2)
+        {
+            int middle = start + width < count ? start + width : count;
+            int end = start + width * 2 < count ? start + width * 2 : count;
+            int a = start;
+            int b = middle;
+            for (int i = start; i < end; ++i)
+            {
+                target[i] = (a < middle && (b >= end || source[a].key <= source[b].key)) ? source[a++] : source[b++];
+            }
+        }
+
+        struct Render_Command *swap = source;
+        source = target;
+        target = swap;
+    }
+
+    if (source != commands->commands)
+    {
+        memcpy(commands->commands, source, sizeof(struct Render_Command) * count);
+    }
+}
+
+// Draws the filled quads written since the last flush in one call
+static void render_commands_flush_quads(struct Render_Commands *commands, int *quad_count)
+{
+    if (*quad_count > 0)
+    {
+        SDL_RenderGeometry(commands->renderer, 0, commands->vertices, *quad_count * 4, commands->indices, *quad_count * 6);
+        ++commands->draw_call_count;
+        *quad_count = 0;
+    }
+}
+
+// Function to draw every recorded rectangle and empty the buffer
+static void render_commands_submit(struct Render_Commands *commands)
+{
+    render_commands_sort(commands);
+
+    int quad_count = 0;
+    int start = 0;
+    while (start < commands->count)
+    {
+        uint64_t key = commands->commands[start].key;
+        int end = start;
+        while (end < commands->count && commands->commands[end].key == key)
+        {
+            commands->rects[end - start] = commands->commands[end].rect;
+            ++end;
+        }
+
+        SDL_Color color = {(Uint8)(key >> 24), (Uint8)(key >> 16), (Uint8)(key >> 8), (Uint8)key};
+        if (commands->raster)
+        {
+            uint32_t value = raster_color(color);
+            for (int i = 0; commands->raster->pixels && i < end - start; ++i)
+            {
+                if (key & (1ull << 32))
+                {
+                    raster_draw_rect(commands->raster, commands->rects + i, value);
+                }
+                else
+                {
+                    raster_fill_rect(commands->raster, commands->rects + i, value);
+                }
+            }
+            start = end;
+            continue;
+        }
+
+        if (key & (1ull << 32))
+        {
+            // Fills sorted before this outline must be drawn before it
+            render_commands_flush_quads(commands, &quad_count);
+            SDL_SetRenderDrawColor(commands->renderer, color.r, color.g, color.b, color.a);
+            SDL_RenderDrawRects(commands->renderer, commands->rects, end - start);
+            ++commands->draw_call_count;
+        }
+        else
+        {
+            for (int i = 0; i < end - start; ++i)
+            {
+                const SDL_Rect *rect = commands->rects + i;
+                float x0 = (float)rect->x;
+                float y0 = (float)rect->y;
+                float x1 = x0 + rect->w;
+                float y1 = y0 + rect->h;
+
+                SDL_Vertex *quad = commands->vertices + quad_count * 4;
+                quad[0] = (SDL_Vertex){{x0, y0}, color, {0, 0}};
+                quad[1] = (SDL_Vertex){{x1, y0}, color, {0, 0}};
+                quad[2] = (SDL_Vertex){{x1, y1}, color, {0, 0}};
+                quad[3] = (SDL_Vertex){{x0, y1}, color, {0, 0}};
+                ++quad_count;
+            }
+        }
+        start = end;
+    }
+    render_commands_flush_quads(commands, &quad_count);
+
+    if (commands->raster && commands->raster->pixels)
+    {
+        raster_end(commands->raster);
+        ++commands->draw_call_count;
+    }
+    commands->count = 0;
+}
+
+#endif
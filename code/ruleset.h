@@ -0,0 +1,241 @@
+#ifndef RULESET_H
+#define RULESET_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+// Scoring, gravity and level-up rules.
+// A ruleset is a block of tables generated once when the ruleset is set up.
+// The engine only indexes into them, so running several rulesets side by side
+// costs no indirect calls and no branches on the rule selection.
+//
+// Custom rulesets are loaded from a text file, one key per line:
+//     # comment
+//     name Custom
+//     points 40 100 300 1200
+//     frames_per_drop 48 43 38 33 28 23 18 13 8 6 5
+//     first_level_lines 10 20 30 40 50 60 70 80 90 100
+//     lines_per_level 10
+// Lists shorter than the table repeat their last value. Points may not be
+// negative, and frames_per_drop and lines_per_level must be positive.
+
+#define RULESET_LEVEL_COUNT 30
+#define RULESET_MAX_CLEAR 4
+
+// Fastest gravity, 20 rows per frame: the guideline's 20G, where a piece
+// reaches the floor of a standard board on the frame it spawns
+#define RULESET_MIN_FRAMES_PER_DROP 0.05f
+
+struct Ruleset
+{
+    char name[32];
+
+    // Points for clearing N lines at once, multiplied by (level + 1)
+    int points[RULESET_MAX_CLEAR + 1];
+
+    // Gravity per level, levels past the table use the last entry; at least
+    // RULESET_MIN_FRAMES_PER_DROP, values below one frame move several rows per frame
+    float frames_per_drop[RULESET_LEVEL_COUNT];
+
+    // Lines needed for the first level up, indexed by starting level
+    int first_level_lines[RULESET_LEVEL_COUNT];
+    int lines_per_level;
+};
+
+static const unsigned char NES_FRAMES_PER_DROP[] = {
+    48,
+    43,
+    38,
+    33,
+    28,
+    23,
+    18,
+    13,
+    8,
+    6,
+    5,
+    5,
+    5,
+    4,
+    4,
+    4,
+    3,
+    3,
+    3,
+    2,
+    2,
+    2,
+    2,
+    2,
+    2,
+    2,
+    2,
+    2,
+    2,
+    1};
+
+static const int NES_POINTS[] = {0, 40, 100, 300, 1200};
+static const int GUIDELINE_POINTS[] = {0, 100, 300, 500, 800};
+
+static int ruleset_clamp_level(int level)
+{
+    return level < 0 ? 0 : (level >= RULESET_LEVEL_COUNT ? RULESET_LEVEL_COUNT - 1 : level);
+}
+
+// Function to fill a ruleset with the original NES rules
+static void ruleset_init_nes(struct Ruleset *rules)
+{
+    memset(rules, 0, sizeof(*rules));
+    snprintf(rules->name, sizeof(rules->name), "NES");
+    memcpy(rules->points, NES_POINTS, sizeof(rules->points));
+
+    for (int level = 0; level < RULESET_LEVEL_COUNT; ++level)
+    {
+        rules->frames_per_drop[level] = NES_FRAMES_PER_DROP[level];
+
+        int first_level_up_limit = level * 10 + 10;
+        int alternative_limit = level * 10 - 50 > 100 ? level * 10 - 50 : 100;
+        if (alternative_limit < first_level_up_limit)
+        {
+            first_level_up_limit = alternative_limit;
+        }
+        rules->first_level_lines[level] = first_level_up_limit;
+    }
+    rules->lines_per_level = 10;
+}
+
+// Function to fill a ruleset with the Tetris Guideline rules
+// Gravity follows the guideline curve (0.8 - (level - 1) * 0.007) ^ (level - 1)
+// seconds per row, with the guideline's level 1 being level 0 here.
+static void ruleset_init_guideline(struct Ruleset *rules)
+{
+    memset(rules, 0, sizeof(*rules));
+    snprintf(rules->name, sizeof(rules->name), "Guideline");
+    memcpy(rules->points, GUIDELINE_POINTS, sizeof(rules->points));
+
+    for (int level = 0; level < RULESET_LEVEL_COUNT; ++level)
+    {
+        double seconds_per_row = pow(0.8 - level * 0.007, level);
+        float frames_per_drop = (float)(seconds_per_row * 60.0);
+        rules->frames_per_drop[level] = frames_per_drop < RULESET_MIN_FRAMES_PER_DROP ? RULESET_MIN_FRAMES_PER_DROP : frames_per_drop;
+        rules->first_level_lines[level] = 10;
+    }
+    rules->lines_per_level = 10;
+}
+
+// Reads up to `capacity` numbers from the rest of a line and repeats the last one
+static bool ruleset_parse_list(const char *text, float *values, int capacity)
+{
+    int count = 0;
+    char *end = 0;
+    while (count < capacity)
+    {
+        double value = strtod(text, &end);
+        if (end == text)
+        {
+            break;
+        }
+        values[count++] = (float)value;
+        text = end;
+    }
+
+    if (count == 0)
+    {
+        return false;
+    }
+
+    for (int i = count; i < capacity; ++i)
+    {
+        values[i] = values[count - 1];
+    }
+    return true;
+}
+
+// Function to load a custom ruleset from a file
+// - rules: ruleset to fill, keys missing from the file keep the NES values
+// - filename: path of the ruleset file
+// - returns false if the file could not be read or has an invalid line
+static bool ruleset_load(struct Ruleset *rules, const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    if (!file)
+    {
+        printf("Failed to open ruleset: %s\n", filename);
+        return false;
+    }
+
+    ruleset_init_nes(rules);
+    snprintf(rules->name, sizeof(rules->name), "Custom");
+
+    char line[1024];
+    int line_number = 0;
+    bool valid = true;
+    while (valid && fgets(line, sizeof(line), file))
+    {
+        ++line_number;
+
+        char key[32];
+        int key_length = 0;
+        if (sscanf(line, " %31s%n", key, &key_length) != 1 || key[0] == '#')
+        {
+            continue;
+        }
+
+        const char *rest = line + key_length;
+        float values[RULESET_LEVEL_COUNT];
+        if (strcmp(key, "name") == 0)
+        {
+            valid = sscanf(rest, " %31[^\r\n]", rules->name) == 1;
+        }
+        else if (strcmp(key, "points") == 0)
+        {
+            valid = ruleset_parse_list(rest, values, RULESET_MAX_CLEAR);
+            for (int i = 0; valid && i < RULESET_MAX_CLEAR; ++i)
+            {
+                valid = values[i] >= 0;
+                rules->points[i + 1] = (int)values[i];
+            }
+        }
+        else if (strcmp(key, "frames_per_drop") == 0)
+        {
+            // Gravity drops rows until it catches up with the clock, so a
+            // drop interval of zero or less would never let it finish; anything
+            // faster than 20G is clamped to it
+            valid = ruleset_parse_list(rest, values, RULESET_LEVEL_COUNT);
+            for (int i = 0; valid && i < RULESET_LEVEL_COUNT; ++i)
+            {
+                valid = values[i] > 0;
+                rules->frames_per_drop[i] = values[i] < RULESET_MIN_FRAMES_PER_DROP ? RULESET_MIN_FRAMES_PER_DROP : values[i];
+            }
+        }
+        else if (strcmp(key, "first_level_lines") == 0)
+        {
+            valid = ruleset_parse_list(rest, values, RULESET_LEVEL_COUNT);
+            for (int i = 0; valid && i < RULESET_LEVEL_COUNT; ++i)
+            {
+                rules->first_level_lines[i] = (int)values[i];
+            }
+        }
+        else if (strcmp(key, "lines_per_level") == 0)
+        {
+            valid = sscanf(rest, "%d", &rules->lines_per_level) == 1 && rules->lines_per_level > 0;
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            printf("Invalid ruleset line %d in %s: %s", line_number, filename, line);
+        }
+    }
+
+    fclose(file);
+    return valid;
+}
+
+#endif
@@ -0,0 +1,946 @@
+#ifndef SCORE_STORE_H
+#define SCORE_STORE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "include/SDL2/SDL.h"
+
+#include "trace.h"
+
+// Persistent high scores.
+// Finished games are appended to a log file that is never rewritten. A
+// background thread writes the records, and everything queued since its last
+// write shares one fsync, so ending a game only copies a record into a queue.
+// Every record carries a CRC. A record torn by a crash fails it: when the store
+// is opened the log is padded back to whole records and damaged records are
+// skipped, so nothing already written is ever touched.
+//
+// Top-K queries are answered from an index file that is memory-mapped next to
+// the log. It holds the best SCORE_STORE_TOP_K records overall and for every
+// player, as record numbers into the log, with players sorted by name so a
+// lookup is a binary search over the mapping. The index covers the log up to
+// a record count; later records are kept in memory and merged into query
+// results, and are folded into a new index when the store closes. The index is
+// written to a temporary file and renamed over the old one, and is rebuilt
+// from the log if it does not match it.
+//
+//   log     "TSCL", u32 version, u32 record size, u32 reserved
+//   record  char player[16], u32 points, u32 lines, u32 level, u32 crc,
+//           u64 replay id, u64 unix time                 (record size bytes)
+//   index   "TSCI", u32 version, u32 top k, u32 player count,
+//           u32 record count, u32 crc of the last record, u32 crc of the
+//           rest of the index, u32 reserved,
+//           u32 global records[top k],
+//           player count times { char player[16], u32 records[top k] }
+//
+// All numbers are little-endian, unused record slots are SCORE_STORE_NO_RECORD.
+
+#define SCORE_STORE_VERSION 1
+#define SCORE_STORE_NAME_SIZE 16
+#define SCORE_STORE_HEADER_SIZE 16
+#define SCORE_STORE_RECORD_SIZE 48
+#define SCORE_STORE_INDEX_HEADER_SIZE 32
+#define SCORE_STORE_TOP_K 10
+#define SCORE_STORE_NO_RECORD 0xFFFFFFFFu
+
+#ifdef _WIN32
+#define SCORE_STORE_FILE HANDLE
+#else
+#define SCORE_STORE_FILE int
+#endif
+
+// Records handed to the writer thread and not yet written
+#define SCORE_STORE_QUEUE_CAPACITY 1024
+
+// Shortest time between two fsyncs, records arriving meanwhile join the next batch
+#define SCORE_STORE_BATCH_MS 250
+
+// Records past the index that opening the store folds into a new index right away
+#define SCORE_STORE_REINDEX_RECORDS 4096
+
+// Records submitted in one session that queries can see before the next index
+#define SCORE_STORE_SESSION_RECORDS 4096
+
+struct Score_Record
+{
+    // NUL padded, longer names are cut
+    char player[SCORE_STORE_NAME_SIZE];
+
+    uint32_t points;
+    uint32_t lines;
+    uint32_t level;
+
+    // Identifies the replay of the game for the caller, 0 for none
+    uint64_t replay_id;
+
+    // Seconds since 1970
+    uint64_t timestamp;
+};
+
+struct Score_Store_Mapping
+{
+    const unsigned char *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+struct Score_Store
+{
+    char log_filename[260];
+    char index_filename[264];
+
+    // The log as it was when the store was opened, and the index over its first records
+    struct Score_Store_Mapping log;
+    struct Score_Store_Mapping index;
+    uint32_t log_count;
+    uint32_t indexed_count;
+    uint32_t player_count;
+
+    // Valid records after the indexed ones and their record numbers, in log order,
+    // owned by the thread submitting scores
+    struct Score_Record *recent;
+    uint32_t *recent_numbers;
+    int recent_count;
+    int recent_capacity;
+
+    // Record number the next submitted score gets
+    uint32_t next_record;
+
+    // Records for the writer thread, one producer and one consumer
+    struct Score_Record queue[SCORE_STORE_QUEUE_CAPACITY];
+    SDL_atomic_t head;
+    SDL_atomic_t tail;
+
+    SDL_sem *wake;
+    SDL_Thread *writer;
+    SDL_atomic_t quit;
+    SDL_atomic_t failed;
+    Uint32 last_flush;
+    SCORE_STORE_FILE log_file;
+    bool log_open;
+};
+
+static uint32_t score_store_read_u32(const unsigned char *bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static uint64_t score_store_read_u64(const unsigned char *bytes)
+{
+    return (uint64_t)score_store_read_u32(bytes) | ((uint64_t)score_store_read_u32(bytes + 4) << 32);
+}
+
+static void score_store_write_u32(unsigned char *bytes, uint32_t value)
+{
+    bytes[0] = (unsigned char)value;
+    bytes[1] = (unsigned char)(value >> 8);
+    bytes[2] = (unsigned char)(value >> 16);
+    bytes[3] = (unsigned char)(value >> 24);
+}
+
+static void score_store_write_u64(unsigned char *bytes, uint64_t value)
+{
+    score_store_write_u32(bytes, (uint32_t)value);
+    score_store_write_u32(bytes + 4, (uint32_t)(value >> 32));
+}
+
+static uint32_t score_store_crc_table[256];
+
+// Function to fill the CRC-32 table, before any thread uses it
+static void score_store_init_crc(void)
+{
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+        score_store_crc_table[i] = crc;
+    }
+}
+
+// Function to continue a CRC-32 over more bytes, starting from 0
+static uint32_t score_store_crc_update(uint32_t crc, const unsigned char *bytes, size_t size)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = (crc >> 8) ^ score_store_crc_table[(crc ^ bytes[i]) & 0xFF];
+    }
+    return ~crc;
+}
+
+// Function to compute the CRC-32 of a record, the crc field counts as zero
+static uint32_t score_store_crc(const unsigned char *record)
+{
+    static const unsigned char zero[4] = {0};
+    uint32_t crc = score_store_crc_update(0, record, 28);
+    crc = score_store_crc_update(crc, zero, 4);
+    return score_store_crc_update(crc, record + 32, SCORE_STORE_RECORD_SIZE - 32);
+}
+
+// Function to serialize a record
+// - bytes: receives SCORE_STORE_RECORD_SIZE bytes
+static void score_store_encode(const struct Score_Record *record, unsigned char *bytes)
+{
+    memset(bytes, 0, SCORE_STORE_RECORD_SIZE);
+    memcpy(bytes, record->player, SCORE_STORE_NAME_SIZE);
+    score_store_write_u32(bytes + 16, record->points);
+    score_store_write_u32(bytes + 20, record->lines);
+    score_store_write_u32(bytes + 24, record->level);
+    score_store_write_u64(bytes + 32, record->replay_id);
+    score_store_write_u64(bytes + 40, record->timestamp);
+    score_store_write_u32(bytes + 28, score_store_crc(bytes));
+}
+
+// Function to check a serialized record against its CRC
+static bool score_store_check(const unsigned char *bytes)
+{
+    return score_store_read_u32(bytes + 28) == score_store_crc(bytes);
+}
+
+// Function to read a serialized record
+static void score_store_decode(const unsigned char *bytes, struct Score_Record *record)
+{
+    memcpy(record->player, bytes, SCORE_STORE_NAME_SIZE);
+    record->player[SCORE_STORE_NAME_SIZE - 1] = 0;
+    record->points = score_store_read_u32(bytes + 16);
+    record->lines = score_store_read_u32(bytes + 20);
+    record->level = score_store_read_u32(bytes + 24);
+    record->replay_id = score_store_read_u64(bytes + 32);
+    record->timestamp = score_store_read_u64(bytes + 40);
+}
+
+// Function to pad a player name the way the files store it
+static void score_store_name(char *name, const char *player)
+{
+    memset(name, 0, SCORE_STORE_NAME_SIZE);
+    snprintf(name, SCORE_STORE_NAME_SIZE, "%s", player);
+}
+
+static const unsigned char *score_store_log_record(const struct Score_Store *store, uint32_t record)
+{
+    return store->log.data + SCORE_STORE_HEADER_SIZE + (size_t)record * SCORE_STORE_RECORD_SIZE;
+}
+
+// Function to memory-map a whole file read-only
+// - returns false if the file is missing or empty
+static bool score_store_map(struct Score_Store_Mapping *mapping, const char *filename)
+{
+    memset(mapping, 0, sizeof(*mapping));
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    HANDLE file_mapping = GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0
+                              ? CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0)
+                              : 0;
+    const void *data = file_mapping ? MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+    if (!data)
+    {
+        if (file_mapping)
+        {
+            CloseHandle(file_mapping);
+        }
+        CloseHandle(file);
+        return false;
+    }
+    mapping->file = file;
+    mapping->mapping = file_mapping;
+    mapping->size = (size_t)file_size.QuadPart;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    void *data = 0;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        data = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        data = data == MAP_FAILED ? 0 : data;
+    }
+    close(fd);
+    if (!data)
+    {
+        return false;
+    }
+    mapping->size = (size_t)info.st_size;
+#endif
+    mapping->data = (const unsigned char *)data;
+    return true;
+}
+
+static void score_store_unmap(struct Score_Store_Mapping *mapping)
+{
+    if (mapping->data)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping->data);
+        CloseHandle(mapping->mapping);
+        CloseHandle(mapping->file);
+#else
+        munmap((void *)mapping->data, mapping->size);
+#endif
+    }
+    memset(mapping, 0, sizeof(*mapping));
+}
+
+// Function to find a player in the index
+// - returns the player's entry, or 0 if the index has no scores of the player
+static const unsigned char *score_store_find_player(const struct Score_Store *store, const char *name)
+{
+    size_t entry_size = SCORE_STORE_NAME_SIZE + 4 * SCORE_STORE_TOP_K;
+    const unsigned char *players = store->index.data + SCORE_STORE_INDEX_HEADER_SIZE + 4 * SCORE_STORE_TOP_K;
+
+    uint32_t low = 0;
+    uint32_t high = store->player_count;
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        int order = memcmp(players + middle * entry_size, name, SCORE_STORE_NAME_SIZE);
+        if (order == 0)
+        {
+            return players + middle * entry_size;
+        }
+        if (order < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return 0;
+}
+
+// Function to check that an index file belongs to the log and use it
+static bool score_store_use_index(struct Score_Store *store)
+{
+    const unsigned char *data = store->index.data;
+    if (!data || store->index.size < SCORE_STORE_INDEX_HEADER_SIZE || memcmp(data, "TSCI", 4) != 0 ||
+        score_store_read_u32(data + 4) != SCORE_STORE_VERSION || score_store_read_u32(data + 8) != SCORE_STORE_TOP_K)
+    {
+        return false;
+    }
+
+    uint32_t player_count = score_store_read_u32(data + 12);
+    uint32_t record_count = score_store_read_u32(data + 16);
+    uint64_t size = SCORE_STORE_INDEX_HEADER_SIZE + 4 * SCORE_STORE_TOP_K +
+                    (uint64_t)player_count * (SCORE_STORE_NAME_SIZE + 4 * SCORE_STORE_TOP_K);
+    if (size != store->index.size || record_count > store->log_count ||
+        (record_count > 0 && score_store_read_u32(data + 20) != score_store_read_u32(score_store_log_record(store, record_count - 1) + 28)) ||
+        score_store_read_u32(data + 24) != score_store_crc_update(0, data + SCORE_STORE_INDEX_HEADER_SIZE, (size_t)size - SCORE_STORE_INDEX_HEADER_SIZE))
+    {
+        return false;
+    }
+
+    // Every record number must point into the indexed part of the log
+    const unsigned char *records = data + SCORE_STORE_INDEX_HEADER_SIZE;
+    for (uint32_t list = 0; list <= player_count; ++list)
+    {
+        for (int i = 0; i < SCORE_STORE_TOP_K; ++i)
+        {
+            uint32_t record = score_store_read_u32(records + i * 4);
+            if (record != SCORE_STORE_NO_RECORD && record >= record_count)
+            {
+                return false;
+            }
+        }
+        records += 4 * SCORE_STORE_TOP_K + SCORE_STORE_NAME_SIZE;
+    }
+
+    store->indexed_count = record_count;
+    store->player_count = player_count;
+    return true;
+}
+
+// Entry of the index being built
+struct Score_Store_Entry
+{
+    char player[SCORE_STORE_NAME_SIZE];
+    uint32_t points;
+    uint32_t record;
+};
+
+// Best first: more points, then the older record
+static int score_store_compare_points(const void *a, const void *b)
+{
+    const struct Score_Store_Entry *x = (const struct Score_Store_Entry *)a;
+    const struct Score_Store_Entry *y = (const struct Score_Store_Entry *)b;
+    if (x->points != y->points)
+    {
+        return x->points > y->points ? -1 : 1;
+    }
+    return (x->record > y->record) - (x->record < y->record);
+}
+
+static int score_store_compare_players(const void *a, const void *b)
+{
+    int order = memcmp(((const struct Score_Store_Entry *)a)->player, ((const struct Score_Store_Entry *)b)->player, SCORE_STORE_NAME_SIZE);
+    return order ? order : score_store_compare_points(a, b);
+}
+
+// Function to insert an entry into a best-first list of at most SCORE_STORE_TOP_K entries
+static void score_store_keep_best(struct Score_Store_Entry *best, int *count, const struct Score_Store_Entry *entry)
+{
+    int position = *count;
+    while (position > 0 && score_store_compare_points(entry, best + position - 1) < 0)
+    {
+        --position;
+    }
+    if (position < SCORE_STORE_TOP_K)
+    {
+        int last = *count < SCORE_STORE_TOP_K ? *count : SCORE_STORE_TOP_K - 1;
+        memmove(best + position + 1, best + position, sizeof(*best) * (last - position));
+        best[position] = *entry;
+        *count = last + 1;
+    }
+}
+
+// Function to add the indexed records of one list to a best-first list
+// - records: SCORE_STORE_TOP_K record numbers from the index
+static void score_store_keep_best_indexed(const struct Score_Store *store, const unsigned char *records, struct Score_Store_Entry *best, int *count)
+{
+    for (int i = 0; i < SCORE_STORE_TOP_K; ++i)
+    {
+        uint32_t record = score_store_read_u32(records + i * 4);
+        if (record != SCORE_STORE_NO_RECORD)
+        {
+            const unsigned char *bytes = score_store_log_record(store, record);
+            struct Score_Store_Entry entry;
+            memcpy(entry.player, bytes, SCORE_STORE_NAME_SIZE);
+            entry.points = score_store_read_u32(bytes + 16);
+            entry.record = record;
+            score_store_keep_best(best, count, &entry);
+        }
+    }
+}
+
+// Function to write a best-first list as SCORE_STORE_TOP_K record numbers
+static void score_store_write_best(unsigned char *records, const struct Score_Store_Entry *best, int count)
+{
+    for (int i = 0; i < SCORE_STORE_TOP_K; ++i)
+    {
+        score_store_write_u32(records + i * 4, i < count ? best[i].record : SCORE_STORE_NO_RECORD);
+    }
+}
+
+// Function to write bytes at the end of a file, score_store_sync_file makes them durable
+// - returns false if the bytes could not be written
+static bool score_store_write_file(SCORE_STORE_FILE file, const unsigned char *bytes, size_t size)
+{
+#ifdef _WIN32
+    DWORD written = 0;
+    return WriteFile(file, bytes, (DWORD)size, &written, 0) && written == size;
+#else
+    while (size > 0)
+    {
+        ssize_t written = write(file, bytes, size);
+        if (written <= 0)
+        {
+            return false;
+        }
+        bytes += written;
+        size -= (size_t)written;
+    }
+    return true;
+#endif
+}
+
+// Function to flush everything written to a file to disk
+// - returns false if the flush failed
+static bool score_store_sync_file(SCORE_STORE_FILE file)
+{
+#ifdef _WIN32
+    return FlushFileBuffers(file) != 0;
+#else
+    return fsync(file) == 0;
+#endif
+}
+
+// Function to fold the recent records into a new index file and map it
+// The new index is built from the old index and the recent records only, so its
+// cost grows with the number of players rather than the length of the log.
+// On failure the old index stays in use.
+// - store: the store, every recent record must be in the log file
+// - returns false if the index could not be written
+static bool score_store_write_index(struct Score_Store *store)
+{
+    int count = store->recent_count;
+    uint32_t old_player_count = store->index.data ? store->player_count : 0;
+    size_t entry_size = SCORE_STORE_NAME_SIZE + 4 * SCORE_STORE_TOP_K;
+    size_t list_offset = SCORE_STORE_INDEX_HEADER_SIZE + 4 * SCORE_STORE_TOP_K;
+    struct Score_Store_Entry *entries = (struct Score_Store_Entry *)malloc(sizeof(struct Score_Store_Entry) * count);
+    unsigned char *data = (unsigned char *)malloc(list_offset + (old_player_count + count) * entry_size);
+    if (!entries || !data)
+    {
+        free(entries);
+        free(data);
+        return false;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        memcpy(entries[i].player, store->recent[i].player, SCORE_STORE_NAME_SIZE);
+        entries[i].points = store->recent[i].points;
+        entries[i].record = store->recent_numbers[i];
+    }
+    qsort(entries, count, sizeof(struct Score_Store_Entry), score_store_compare_players);
+
+    struct Score_Store_Entry best[SCORE_STORE_TOP_K];
+    int best_count = 0;
+    if (store->index.data)
+    {
+        score_store_keep_best_indexed(store, store->index.data + SCORE_STORE_INDEX_HEADER_SIZE, best, &best_count);
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        score_store_keep_best(best, &best_count, entries + i);
+    }
+    score_store_write_best(data + SCORE_STORE_INDEX_HEADER_SIZE, best, best_count);
+
+    // Both the old players and the recent records are sorted by name, players
+    // without recent records are copied as they are
+    const unsigned char *old_players = store->index.data ? store->index.data + list_offset : 0;
+    unsigned char *player_entry = data + list_offset;
+    uint32_t player_count = 0;
+    uint32_t old_player = 0;
+    int next = 0;
+    while (old_player < old_player_count || next < count)
+    {
+        const unsigned char *old_entry = old_player < old_player_count ? old_players + old_player * entry_size : 0;
+        int order = !old_entry ? 1 : (next == count ? -1 : memcmp(old_entry, entries[next].player, SCORE_STORE_NAME_SIZE));
+        if (order < 0)
+        {
+            memcpy(player_entry, old_entry, entry_size);
+            ++old_player;
+        }
+        else
+        {
+            best_count = 0;
+            if (order == 0)
+            {
+                score_store_keep_best_indexed(store, old_entry + SCORE_STORE_NAME_SIZE, best, &best_count);
+                ++old_player;
+            }
+
+            const char *name = entries[next].player;
+            for (; next < count && memcmp(entries[next].player, name, SCORE_STORE_NAME_SIZE) == 0; ++next)
+            {
+                score_store_keep_best(best, &best_count, entries + next);
+            }
+            memcpy(player_entry, best[0].player, SCORE_STORE_NAME_SIZE);
+            score_store_write_best(player_entry + SCORE_STORE_NAME_SIZE, best, best_count);
+        }
+        player_entry += entry_size;
+        ++player_count;
+    }
+    size_t size = (size_t)(player_entry - data);
+
+    // The index covers the log up to the last recent record, the same bytes as written
+    unsigned char last_record[SCORE_STORE_RECORD_SIZE];
+    score_store_encode(store->recent + count - 1, last_record);
+    uint32_t record_count = store->recent_numbers[count - 1] + 1;
+    memset(data, 0, SCORE_STORE_INDEX_HEADER_SIZE);
+    memcpy(data, "TSCI", 4);
+    score_store_write_u32(data + 4, SCORE_STORE_VERSION);
+    score_store_write_u32(data + 8, SCORE_STORE_TOP_K);
+    score_store_write_u32(data + 12, player_count);
+    score_store_write_u32(data + 16, record_count);
+    score_store_write_u32(data + 20, score_store_read_u32(last_record + 28));
+    score_store_write_u32(data + 24, score_store_crc_update(0, data + SCORE_STORE_INDEX_HEADER_SIZE, size - SCORE_STORE_INDEX_HEADER_SIZE));
+    free(entries);
+
+    // Written next to the old index and renamed over it, so a crash leaves one or the other
+    char temp_filename[sizeof(store->index_filename) + 4];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", store->index_filename);
+#ifdef _WIN32
+    HANDLE file = CreateFileA(temp_filename, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+    bool written = file != INVALID_HANDLE_VALUE && score_store_write_file(file, data, size) && score_store_sync_file(file);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file);
+    }
+#else
+    int file = open(temp_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool written = file >= 0 && score_store_write_file(file, data, size) && score_store_sync_file(file);
+    if (file >= 0)
+    {
+        close(file);
+    }
+#endif
+    free(data);
+
+    // A mapped file cannot be replaced on Windows
+    score_store_unmap(&store->index);
+#ifdef _WIN32
+    written = written && MoveFileExA(temp_filename, store->index_filename, MOVEFILE_REPLACE_EXISTING);
+#else
+    written = written && rename(temp_filename, store->index_filename) == 0;
+#endif
+    if (written)
+    {
+        store->indexed_count = record_count;
+        store->player_count = player_count;
+        store->recent_count = 0;
+    }
+    else
+    {
+        printf("Failed to write %s\n", store->index_filename);
+        remove(temp_filename);
+    }
+    score_store_map(&store->index, store->index_filename);
+    return written;
+}
+
+// Function to write every queued record, called by the writer thread
+static void score_store_flush(struct Score_Store *store)
+{
+    unsigned char bytes[64 * SCORE_STORE_RECORD_SIZE];
+    int head = SDL_AtomicGet(&store->head);
+    int tail = SDL_AtomicGet(&store->tail);
+    if (head == tail)
+    {
+        return;
+    }
+
+    // Written in chunks, synced once for the whole batch
+    while (head != tail)
+    {
+        int count = 0;
+        for (; head != tail && count < 64; ++head, ++count)
+        {
+            score_store_encode(store->queue + head % SCORE_STORE_QUEUE_CAPACITY, bytes + count * SCORE_STORE_RECORD_SIZE);
+        }
+        if (!SDL_AtomicGet(&store->failed) && !score_store_write_file(store->log_file, bytes, (size_t)count * SCORE_STORE_RECORD_SIZE))
+        {
+            printf("Failed to write scores to %s\n", store->log_filename);
+            SDL_AtomicSet(&store->failed, 1);
+        }
+
+        // SDL_AtomicSet is a full barrier, the slots are free once the head has moved
+        SDL_AtomicSet(&store->head, head);
+        tail = SDL_AtomicGet(&store->tail);
+    }
+    if (!SDL_AtomicGet(&store->failed) && !score_store_sync_file(store->log_file))
+    {
+        printf("Failed to write scores to %s\n", store->log_filename);
+        SDL_AtomicSet(&store->failed, 1);
+    }
+    store->last_flush = SDL_GetTicks();
+}
+
+static int score_store_run_writer(void *data)
+{
+    struct Score_Store *store = (struct Score_Store *)data;
+    trace_thread_name("scores");
+
+    while (!SDL_AtomicGet(&store->quit))
+    {
+        SDL_SemWait(store->wake);
+
+        // Records submitted within the batch window share the next fsync. Every
+        // submit posts the semaphore, so the wait is repeated until the window
+        // has passed; only closing the store ends it early.
+        Uint32 deadline = store->last_flush + SCORE_STORE_BATCH_MS;
+        Sint32 remaining = (Sint32)(deadline - SDL_GetTicks());
+        while (remaining > 0 && !SDL_AtomicGet(&store->quit))
+        {
+            SDL_SemWaitTimeout(store->wake, (Uint32)remaining);
+            remaining = (Sint32)(deadline - SDL_GetTicks());
+        }
+        score_store_flush(store);
+    }
+    score_store_flush(store);
+    return 0;
+}
+
+// Function to write the remaining scores, update the index and close the store
+static void score_store_close(struct Score_Store *store)
+{
+    if (store->writer)
+    {
+        SDL_AtomicSet(&store->quit, 1);
+        SDL_SemPost(store->wake);
+        SDL_WaitThread(store->writer, 0);
+    }
+    if (store->wake)
+    {
+        SDL_DestroySemaphore(store->wake);
+    }
+
+    // The index may only point at records that made it into the log
+    if (store->recent_count > 0 && !SDL_AtomicGet(&store->failed))
+    {
+        score_store_write_index(store);
+    }
+
+    if (store->log_open)
+    {
+#ifdef _WIN32
+        CloseHandle(store->log_file);
+#else
+        close(store->log_file);
+#endif
+    }
+    score_store_unmap(&store->index);
+    score_store_unmap(&store->log);
+    free(store->recent);
+    free(store->recent_numbers);
+    memset(store, 0, sizeof(*store));
+}
+
+// Function to open a score store, creating the log if needed
+// A torn record at the end of the log is padded to a whole one, and the index is
+// rebuilt if it does not match the log or too many records have piled up after it.
+// - store: store to initialize
+// - log_filename: path of the log, the index is the same path with ".idx" appended
+// - returns false if the log is not a score log or cannot be written
+static bool score_store_open(struct Score_Store *store, const char *log_filename)
+{
+    memset(store, 0, sizeof(*store));
+    score_store_init_crc();
+    snprintf(store->log_filename, sizeof(store->log_filename), "%s", log_filename);
+    snprintf(store->index_filename, sizeof(store->index_filename), "%s.idx", log_filename);
+
+    FILE *file = fopen(log_filename, "ab");
+    if (!file)
+    {
+        printf("Failed to open %s\n", log_filename);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    if (size == 0)
+    {
+        unsigned char header[SCORE_STORE_HEADER_SIZE] = {'T', 'S', 'C', 'L'};
+        score_store_write_u32(header + 4, SCORE_STORE_VERSION);
+        score_store_write_u32(header + 8, SCORE_STORE_RECORD_SIZE);
+        fwrite(header, 1, sizeof(header), file);
+    }
+    else if (size > SCORE_STORE_HEADER_SIZE && (size - SCORE_STORE_HEADER_SIZE) % SCORE_STORE_RECORD_SIZE != 0)
+    {
+        // New records must start on a record boundary, the torn one fails its CRC
+        unsigned char padding[SCORE_STORE_RECORD_SIZE] = {0};
+        long padding_size = SCORE_STORE_RECORD_SIZE - (size - SCORE_STORE_HEADER_SIZE) % SCORE_STORE_RECORD_SIZE;
+        printf("%s: padding a torn score with %ld bytes\n", log_filename, padding_size);
+        fwrite(padding, 1, (size_t)padding_size, file);
+    }
+    bool prepared = fflush(file) == 0;
+    fclose(file);
+    if (!prepared)
+    {
+        printf("Failed to write %s\n", log_filename);
+        return false;
+    }
+
+    if (!score_store_map(&store->log, log_filename) || store->log.size < SCORE_STORE_HEADER_SIZE ||
+        memcmp(store->log.data, "TSCL", 4) != 0 || score_store_read_u32(store->log.data + 4) != SCORE_STORE_VERSION ||
+        score_store_read_u32(store->log.data + 8) != SCORE_STORE_RECORD_SIZE ||
+        (store->log.size - SCORE_STORE_HEADER_SIZE) / SCORE_STORE_RECORD_SIZE >= SCORE_STORE_NO_RECORD)
+    {
+        printf("%s is not a score log\n", log_filename);
+        score_store_unmap(&store->log);
+        return false;
+    }
+    store->log_count = (uint32_t)((store->log.size - SCORE_STORE_HEADER_SIZE) / SCORE_STORE_RECORD_SIZE);
+
+    score_store_map(&store->index, store->index_filename);
+    if (!score_store_use_index(store))
+    {
+        score_store_unmap(&store->index);
+        store->indexed_count = 0;
+        store->player_count = 0;
+    }
+
+    // Only records past the index are checked, the indexed ones were checked when they were indexed
+    uint32_t tail_count = store->log_count - store->indexed_count;
+    store->recent_capacity = (int)tail_count + SCORE_STORE_SESSION_RECORDS;
+    store->recent = (struct Score_Record *)malloc(sizeof(struct Score_Record) * store->recent_capacity);
+    store->recent_numbers = (uint32_t *)malloc(sizeof(uint32_t) * store->recent_capacity);
+    if (!store->recent || !store->recent_numbers)
+    {
+        score_store_close(store);
+        return false;
+    }
+
+    uint32_t damaged_count = 0;
+    for (uint32_t record = store->indexed_count; record < store->log_count; ++record)
+    {
+        const unsigned char *bytes = score_store_log_record(store, record);
+        if (score_store_check(bytes))
+        {
+            score_store_decode(bytes, store->recent + store->recent_count);
+            store->recent_numbers[store->recent_count++] = record;
+        }
+        else
+        {
+            ++damaged_count;
+        }
+    }
+    if (damaged_count > 0)
+    {
+        printf("%s: skipping %u damaged scores\n", log_filename, damaged_count);
+    }
+    store->next_record = store->log_count;
+
+    if (store->recent_count > SCORE_STORE_REINDEX_RECORDS)
+    {
+        score_store_write_index(store);
+    }
+
+#ifdef _WIN32
+    store->log_file = CreateFileA(log_filename, FILE_APPEND_DATA, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    store->log_open = store->log_file != INVALID_HANDLE_VALUE;
+#else
+    store->log_file = open(log_filename, O_WRONLY | O_APPEND);
+    store->log_open = store->log_file >= 0;
+#endif
+    if (!store->log_open)
+    {
+        printf("Failed to open %s for writing\n", log_filename);
+        score_store_close(store);
+        return false;
+    }
+
+    // Without a writer thread records are written as they are submitted
+    store->wake = SDL_CreateSemaphore(0);
+    store->writer = store->wake ? SDL_CreateThread(score_store_run_writer, "scores", store) : 0;
+    return true;
+}
+
+// Function to record a finished game, never waits for the disk
+// - store: the store
+// - record: the score, the player name is cut to SCORE_STORE_NAME_SIZE - 1 characters
+// - returns false if the writer is too far behind and the score was dropped
+static bool score_store_submit(struct Score_Store *store, const struct Score_Record *record)
+{
+    int tail = SDL_AtomicGet(&store->tail);
+    if (tail - SDL_AtomicGet(&store->head) == SCORE_STORE_QUEUE_CAPACITY)
+    {
+        printf("Score queue full, score dropped\n");
+        return false;
+    }
+
+    struct Score_Record *slot = store->queue + tail % SCORE_STORE_QUEUE_CAPACITY;
+    *slot = *record;
+    char player[SCORE_STORE_NAME_SIZE];
+    score_store_name(player, record->player);
+    memcpy(slot->player, player, SCORE_STORE_NAME_SIZE);
+
+    // Queries see the score right away; past the session capacity it waits for the next index
+    if (store->recent_count < store->recent_capacity)
+    {
+        store->recent[store->recent_count] = *slot;
+        store->recent_numbers[store->recent_count++] = store->next_record;
+    }
+    ++store->next_record;
+
+    SDL_AtomicSet(&store->tail, tail + 1);
+    if (store->writer)
+    {
+        SDL_SemPost(store->wake);
+    }
+    else
+    {
+        score_store_flush(store);
+    }
+    return true;
+}
+
+// Function to insert a record into a best-first list of at most k records
+static void score_store_insert(struct Score_Record *best, uint32_t *best_records, int *count, int k, const struct Score_Record *record, uint32_t record_number)
+{
+    int position = *count;
+    while (position > 0 && (best[position - 1].points < record->points ||
+                            (best[position - 1].points == record->points && best_records[position - 1] > record_number)))
+    {
+        --position;
+    }
+    if (position >= k)
+    {
+        return;
+    }
+
+    int last = *count < k ? *count : k - 1;
+    memmove(best + position + 1, best + position, sizeof(*best) * (last - position));
+    memmove(best_records + position + 1, best_records + position, sizeof(*best_records) * (last - position));
+    best[position] = *record;
+    best_records[position] = record_number;
+    *count = last + 1;
+}
+
+// Function to find the best scores
+// - store: the store
+// - player: player to find the scores of, or 0 for the best scores of everyone
+// - best: receives the scores, best first
+// - k: scores wanted, at most SCORE_STORE_TOP_K
+// - returns the number of scores found
+static int score_store_top(const struct Score_Store *store, const char *player, struct Score_Record *best, int k)
+{
+    k = k < SCORE_STORE_TOP_K ? k : SCORE_STORE_TOP_K;
+    uint32_t best_records[SCORE_STORE_TOP_K];
+    int count = 0;
+
+    char name[SCORE_STORE_NAME_SIZE];
+    const unsigned char *records = 0;
+    if (player)
+    {
+        score_store_name(name, player);
+        const unsigned char *entry = store->index.data ? score_store_find_player(store, name) : 0;
+        records = entry ? entry + SCORE_STORE_NAME_SIZE : 0;
+    }
+    else if (store->index.data)
+    {
+        records = store->index.data + SCORE_STORE_INDEX_HEADER_SIZE;
+    }
+
+    for (int i = 0; records && i < SCORE_STORE_TOP_K; ++i)
+    {
+        uint32_t record_number = score_store_read_u32(records + i * 4);
+        struct Score_Record record;
+        if (record_number != SCORE_STORE_NO_RECORD)
+        {
+            score_store_decode(score_store_log_record(store, record_number), &record);
+            score_store_insert(best, best_records, &count, k, &record, record_number);
+        }
+    }
+
+    for (int i = 0; i < store->recent_count; ++i)
+    {
+        if (!player || memcmp(store->recent[i].player, name, SCORE_STORE_NAME_SIZE) == 0)
+        {
+            score_store_insert(best, best_records, &count, k, store->recent + i, store->recent_numbers[i]);
+        }
+    }
+    return count;
+}
+
+#endif
@@ -0,0 +1,393 @@
+#ifndef TERMINAL_H
+#define TERMINAL_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+// Character grid drawn to an ANSI terminal with 24-bit color escapes.
+// A frame is drawn into `cells` and terminal_present sends only the cells that
+// differ from what the terminal already shows, moving the cursor only across
+// gaps and repeating a color escape only when the color changes. The bytes
+// written per frame are counted next to what a full redraw of the same frame
+// would have cost. Keyboard input is read in raw mode without waiting; arrow
+// keys arrive as TERMINAL_KEY codes and every other key as its byte.
+
+enum Terminal_Key
+{
+    TERMINAL_KEY_NONE = 0,
+
+    // Above every byte value
+    TERMINAL_KEY_UP = 256,
+    TERMINAL_KEY_DOWN,
+    TERMINAL_KEY_RIGHT,
+    TERMINAL_KEY_LEFT,
+    TERMINAL_KEY_ESCAPE
+};
+
+struct Terminal_Cell
+{
+    char ch;
+
+    // 0xRRGGBB
+    uint32_t fg;
+    uint32_t bg;
+};
+
+struct Terminal
+{
+    int columns;
+    int rows;
+
+    // Frame being drawn and what the terminal shows
+    struct Terminal_Cell *cells;
+    struct Terminal_Cell *shown;
+    bool shown_valid;
+
+    char *output;
+    size_t output_size;
+    size_t output_capacity;
+
+    // Bytes written by the last frame, and by a full redraw of it
+    size_t frame_bytes;
+    size_t full_frame_bytes;
+    unsigned long long total_bytes;
+    unsigned long long total_full_bytes;
+    int frame_count;
+
+    // Bytes read but not yet turned into keys
+    unsigned char input[64];
+    int input_count;
+
+#ifdef _WIN32
+    HANDLE input_handle;
+    HANDLE output_handle;
+    DWORD saved_input_mode;
+    DWORD saved_output_mode;
+#else
+    struct termios saved_mode;
+#endif
+    bool raw;
+};
+
+// Function to switch the terminal to raw mode and the alternate screen
+// - terminal: terminal to initialize
+// - columns, rows: size of the character grid
+// - returns false if stdin is not a terminal or out of memory
+static bool terminal_open(struct Terminal *terminal, int columns, int rows)
+{
+    memset(terminal, 0, sizeof(*terminal));
+    terminal->columns = columns;
+    terminal->rows = rows;
+    terminal->cells = (struct Terminal_Cell *)calloc((size_t)columns * rows, sizeof(struct Terminal_Cell));
+    terminal->shown = (struct Terminal_Cell *)calloc((size_t)columns * rows, sizeof(struct Terminal_Cell));
+    terminal->output_capacity = 4096;
+    terminal->output = (char *)malloc(terminal->output_capacity);
+    if (!terminal->cells || !terminal->shown || !terminal->output)
+    {
+        return false;
+    }
+
+#ifdef _WIN32
+    terminal->input_handle = GetStdHandle(STD_INPUT_HANDLE);
+    terminal->output_handle = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (!GetConsoleMode(terminal->input_handle, &terminal->saved_input_mode) ||
+        !GetConsoleMode(terminal->output_handle, &terminal->saved_output_mode))
+    {
+        printf("The terminal frontend needs a console\n");
+        return false;
+    }
+
+    // 0x0004 is ENABLE_VIRTUAL_TERMINAL_PROCESSING, missing from older headers
+    SetConsoleMode(terminal->input_handle, 0);
+    SetConsoleMode(terminal->output_handle, terminal->saved_output_mode | ENABLE_PROCESSED_OUTPUT | 0x0004);
+#else
+    if (tcgetattr(STDIN_FILENO, &terminal->saved_mode) != 0)
+    {
+        printf("The terminal frontend needs a terminal\n");
+        return false;
+    }
+
+    // No echo, no line buffering, no signals from Ctrl-C, and reads return at once
+    struct termios mode = terminal->saved_mode;
+    mode.c_iflag &= ~(tcflag_t)(IXON | ICRNL | BRKINT | INPCK | ISTRIP);
+    mode.c_lflag &= ~(tcflag_t)(ECHO | ICANON | ISIG | IEXTEN);
+    mode.c_cc[VMIN] = 0;
+    mode.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &mode);
+#endif
+    terminal->raw = true;
+
+    // Alternate screen, hidden cursor, cleared
+    fputs("\x1b[?1049h\x1b[?25l\x1b[2J", stdout);
+    fflush(stdout);
+    return true;
+}
+
+// Function to restore the terminal and release the grid
+static void terminal_close(struct Terminal *terminal)
+{
+    if (terminal->raw)
+    {
+        fputs("\x1b[0m\x1b[?25h\x1b[?1049l", stdout);
+        fflush(stdout);
+#ifdef _WIN32
+        SetConsoleMode(terminal->input_handle, terminal->saved_input_mode);
+        SetConsoleMode(terminal->output_handle, terminal->saved_output_mode);
+#else
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &terminal->saved_mode);
+#endif
+    }
+    free(terminal->cells);
+    free(terminal->shown);
+    free(terminal->output);
+    terminal->cells = 0;
+    terminal->shown = 0;
+    terminal->output = 0;
+    terminal->raw = false;
+}
+
+// Function to read the bytes typed since the last call into the input buffer
+static void terminal_fill_input(struct Terminal *terminal)
+{
+    int space = (int)sizeof(terminal->input) - terminal->input_count;
+#ifdef _WIN32
+    // Key events are translated to the bytes a VT terminal would send
+    DWORD event_count = 0;
+    while (space >= 3 && GetNumberOfConsoleInputEvents(terminal->input_handle, &event_count) && event_count > 0)
+    {
+        INPUT_RECORD record;
+        DWORD read_count = 0;
+        if (!ReadConsoleInputA(terminal->input_handle, &record, 1, &read_count) || read_count == 0)
+        {
+            break;
+        }
+        if (record.EventType != KEY_EVENT || !record.Event.KeyEvent.bKeyDown)
+        {
+            continue;
+        }
+
+        char arrow = 0;
+        switch (record.Event.KeyEvent.wVirtualKeyCode)
+        {
+        case VK_UP:
+            arrow = 'A';
+            break;
+        case VK_DOWN:
+            arrow = 'B';
+            break;
+        case VK_RIGHT:
+            arrow = 'C';
+            break;
+        case VK_LEFT:
+            arrow = 'D';
+            break;
+        }
+        unsigned char *end = terminal->input + terminal->input_count;
+        if (arrow)
+        {
+            end[0] = 0x1b;
+            end[1] = '[';
+            end[2] = (unsigned char)arrow;
+            terminal->input_count += 3;
+            space -= 3;
+        }
+        else if (record.Event.KeyEvent.uChar.AsciiChar)
+        {
+            end[0] = (unsigned char)record.Event.KeyEvent.uChar.AsciiChar;
+            ++terminal->input_count;
+            --space;
+        }
+    }
+#else
+    if (space > 0)
+    {
+        ssize_t count = read(STDIN_FILENO, terminal->input + terminal->input_count, (size_t)space);
+        terminal->input_count += count > 0 ? (int)count : 0;
+    }
+#endif
+}
+
+// Function to take the next key typed, without waiting
+// - returns a TERMINAL_KEY code or the byte of the key, TERMINAL_KEY_NONE if nothing was typed
+static int terminal_read_key(struct Terminal *terminal)
+{
+    if (terminal->input_count == 0)
+    {
+        terminal_fill_input(terminal);
+    }
+    if (terminal->input_count == 0)
+    {
+        return TERMINAL_KEY_NONE;
+    }
+
+    int key = terminal->input[0];
+    int length = 1;
+    if (key == 0x1b)
+    {
+        // Arrow keys are "ESC [ A" or "ESC O A", a lone ESC is the escape key
+        key = TERMINAL_KEY_ESCAPE;
+        if (terminal->input_count >= 3 && (terminal->input[1] == '[' || terminal->input[1] == 'O'))
+        {
+            length = 3;
+            switch (terminal->input[2])
+            {
+            case 'A':
+                key = TERMINAL_KEY_UP;
+                break;
+            case 'B':
+                key = TERMINAL_KEY_DOWN;
+                break;
+            case 'C':
+                key = TERMINAL_KEY_RIGHT;
+                break;
+            case 'D':
+                key = TERMINAL_KEY_LEFT;
+                break;
+            default:
+                key = TERMINAL_KEY_NONE;
+                break;
+            }
+        }
+    }
+
+    terminal->input_count -= length;
+    memmove(terminal->input, terminal->input + length, terminal->input_count);
+    return key;
+}
+
+// Function to fill the whole grid with one color
+static void terminal_clear(struct Terminal *terminal, uint32_t bg)
+{
+    for (int i = 0; i < terminal->columns * terminal->rows; ++i)
+    {
+        terminal->cells[i].ch = ' ';
+        terminal->cells[i].fg = bg;
+        terminal->cells[i].bg = bg;
+    }
+}
+
+// Function to set one cell, cells outside the grid are ignored
+static void terminal_put(struct Terminal *terminal, int row, int col, char ch, uint32_t fg, uint32_t bg)
+{
+    if (row < 0 || row >= terminal->rows || col < 0 || col >= terminal->columns)
+    {
+        return;
+    }
+    struct Terminal_Cell *cell = terminal->cells + row * terminal->columns + col;
+    cell->ch = ch;
+    cell->fg = fg;
+    cell->bg = bg;
+}
+
+// Function to write text over the grid, keeping the background of each cell
+static void terminal_text(struct Terminal *terminal, int row, int col, const char *text, uint32_t fg)
+{
+    for (; *text; ++text, ++col)
+    {
+        if (row >= 0 && row < terminal->rows && col >= 0 && col < terminal->columns)
+        {
+            struct Terminal_Cell *cell = terminal->cells + row * terminal->columns + col;
+            terminal_put(terminal, row, col, *text, fg, cell->bg);
+        }
+    }
+}
+
+static void terminal_append(struct Terminal *terminal, const char *text, size_t length)
+{
+    if (terminal->output_size + length > terminal->output_capacity)
+    {
+        size_t capacity = terminal->output_capacity * 2 + length;
+        char *output = (char *)realloc(terminal->output, capacity);
+        if (!output)
+        {
+            return;
+        }
+        terminal->output = output;
+        terminal->output_capacity = capacity;
+    }
+    memcpy(terminal->output + terminal->output_size, text, length);
+    terminal->output_size += length;
+}
+
+// Function to build the escapes that bring the terminal from `shown` to `cells`
+// - terminal: the terminal, its output buffer receives the escapes
+// - all: emit every cell as if nothing was shown
+static void terminal_encode(struct Terminal *terminal, bool all)
+{
+    char escape[48];
+    int cursor_row = -1;
+    int cursor_col = -1;
+    uint32_t fg = 0xFFFFFFFF;
+    uint32_t bg = 0xFFFFFFFF;
+
+    for (int row = 0; row < terminal->rows; ++row)
+    {
+        for (int col = 0; col < terminal->columns; ++col)
+        {
+            const struct Terminal_Cell *cell = terminal->cells + row * terminal->columns + col;
+            const struct Terminal_Cell *shown = terminal->shown + row * terminal->columns + col;
+            if (!all && cell->ch == shown->ch && cell->fg == shown->fg && cell->bg == shown->bg)
+            {
+                continue;
+            }
+
+            if (row != cursor_row || col != cursor_col)
+            {
+                terminal_append(terminal, escape, snprintf(escape, sizeof(escape), "\x1b[%d;%dH", row + 1, col + 1));
+            }
+            if (cell->bg != bg)
+            {
+                bg = cell->bg;
+                terminal_append(terminal, escape, snprintf(escape, sizeof(escape), "\x1b[48;2;%u;%u;%um",
+                                                           (unsigned)(bg >> 16), (unsigned)(bg >> 8 & 0xFF), (unsigned)(bg & 0xFF)));
+            }
+            if (cell->fg != fg && cell->ch != ' ')
+            {
+                fg = cell->fg;
+                terminal_append(terminal, escape, snprintf(escape, sizeof(escape), "\x1b[38;2;%u;%u;%um",
+                                                           (unsigned)(fg >> 16), (unsigned)(fg >> 8 & 0xFF), (unsigned)(fg & 0xFF)));
+            }
+            terminal_append(terminal, &cell->ch, 1);
+            cursor_row = row;
+            cursor_col = col + 1;
+        }
+    }
+}
+
+// Function to send the changed cells to the terminal and count the bytes
+static void terminal_present(struct Terminal *terminal)
+{
+    // What a full redraw would cost, for comparison only
+    terminal->output_size = 0;
+    terminal_encode(terminal, true);
+    terminal->full_frame_bytes = terminal->output_size;
+
+    terminal->output_size = 0;
+    terminal_encode(terminal, !terminal->shown_valid);
+    terminal->frame_bytes = terminal->output_size;
+    if (terminal->output_size > 0)
+    {
+        fwrite(terminal->output, 1, terminal->output_size, stdout);
+        fflush(stdout);
+    }
+
+    memcpy(terminal->shown, terminal->cells, sizeof(struct Terminal_Cell) * terminal->columns * terminal->rows);
+    terminal->shown_valid = true;
+    terminal->total_bytes += terminal->frame_bytes;
+    terminal->total_full_bytes += terminal->full_frame_bytes;
+    ++terminal->frame_count;
+}
+
+#endif
@@ -0,0 +1,285 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "include/SDL2/SDL.h"
+
+// Scoped trace markers exported as Chrome/Perfetto trace JSON.
+// Compile with -DTRACING to enable them; otherwise every macro expands to
+// nothing (or to the wrapped call) and the functions are empty stubs.
+// Each thread records complete events into its own buffer, so recording never
+// takes a lock; the buffers are only read by trace_write once the other
+// threads have stopped. Hot-path counters are summed across threads and
+// emitted as counter tracks once per frame. Open the written file in
+// chrome://tracing or ui.perfetto.dev.
+
+enum Trace_Counter
+{
+    TRACE_COUNTER_COLLISION_TESTS,
+    TRACE_COUNTER_ROWS_SCANNED,
+    TRACE_COUNTER_GLYPHS_DRAWN,
+    TRACE_COUNTER_MIXER_CALLS,
+
+    TRACE_COUNTER_COUNT
+};
+
+#ifdef TRACING
+
+#define TRACE_EVENTS_PER_THREAD (1 << 16)
+#define TRACE_MAX_THREADS 8
+
+static const char *TRACE_COUNTER_NAMES[TRACE_COUNTER_COUNT] = {
+    "collision tests",
+    "rows scanned",
+    "glyphs drawn",
+    "mixer calls"};
+
+struct Trace_Event
+{
+    // String literal, never copied
+    const char *name;
+    Uint64 start;
+
+    // Duration in ticks, or the value for counter events
+    Uint64 value;
+    bool counter;
+};
+
+struct Trace_Thread
+{
+    SDL_threadID id;
+    const char *name;
+    int count;
+    int dropped_count;
+    struct Trace_Event events[TRACE_EVENTS_PER_THREAD];
+};
+
+struct Trace
+{
+    Uint64 start;
+    Uint64 frequency;
+    SDL_atomic_t thread_count;
+    struct Trace_Thread *threads[TRACE_MAX_THREADS];
+    SDL_atomic_t counters[TRACE_COUNTER_COUNT];
+};
+
+static struct Trace trace;
+static _Thread_local struct Trace_Thread *trace_thread;
+
+static void trace_init(void)
+{
+    trace.start = SDL_GetPerformanceCounter();
+    trace.frequency = SDL_GetPerformanceFrequency();
+}
+
+// Function to get the event buffer of the calling thread, created on first use
+// - returns 0 if every buffer is taken
+static struct Trace_Thread *trace_get_thread(void)
+{
+    if (trace_thread)
+    {
+        return trace_thread;
+    }
+
+    int index = SDL_AtomicAdd(&trace.thread_count, 1);
+    if (index >= TRACE_MAX_THREADS)
+    {
+        return 0;
+    }
+
+    trace_thread = (struct Trace_Thread *)calloc(1, sizeof(struct Trace_Thread));
+    if (trace_thread)
+    {
+        trace_thread->id = SDL_ThreadID();
+    }
+    trace.threads[index] = trace_thread;
+    return trace_thread;
+}
+
+static void trace_record(const char *name, Uint64 start, Uint64 value, bool counter)
+{
+    struct Trace_Thread *thread = trace_get_thread();
+    if (!thread)
+    {
+        return;
+    }
+    if (thread->count == TRACE_EVENTS_PER_THREAD)
+    {
+        ++thread->dropped_count;
+        return;
+    }
+
+    struct Trace_Event *event = thread->events + thread->count++;
+    event->name = name;
+    event->start = start;
+    event->value = value;
+    event->counter = counter;
+}
+
+// Function to name the calling thread in the trace
+static void trace_thread_name(const char *name)
+{
+    struct Trace_Thread *thread = trace_get_thread();
+    if (thread)
+    {
+        thread->name = name;
+    }
+}
+
+struct Trace_Scope
+{
+    const char *name;
+    Uint64 start;
+};
+
+static struct Trace_Scope trace_scope_begin(const char *name)
+{
+    struct Trace_Scope scope = {name, SDL_GetPerformanceCounter()};
+    return scope;
+}
+
+static void trace_scope_end(struct Trace_Scope *scope)
+{
+    trace_record(scope->name, scope->start, SDL_GetPerformanceCounter() - scope->start, false);
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+// Records the rest of the enclosing block as one event, ended by the cleanup attribute
+#define TRACE_SCOPE(name) \
+    struct Trace_Scope TRACE_CONCAT(trace_scope_, __LINE__) __attribute__((cleanup(trace_scope_end))) = trace_scope_begin(name)
+
+#define TRACE_COUNT(counter) SDL_AtomicIncRef(&trace.counters[counter])
+
+#define TRACE_COUNT_N(counter, n) SDL_AtomicAdd(&trace.counters[counter], n)
+
+// Records a single call as an event named after the call and counts it
+#define TRACE_CALL(counter, call) \
+    do                            \
+    {                             \
+        TRACE_SCOPE(#call);       \
+        TRACE_COUNT(counter);     \
+        call;                     \
+    } while (0)
+
+// Function to emit the hot-path counters of the finished frame and reset them
+static void trace_frame_end(void)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    for (int counter = 0; counter < TRACE_COUNTER_COUNT; ++counter)
+    {
+        int value = SDL_AtomicSet(&trace.counters[counter], 0);
+        trace_record(TRACE_COUNTER_NAMES[counter], now, (Uint64)value, true);
+    }
+}
+
+// Function to write every recorded event as Chrome trace JSON
+// Other threads must not record events while this runs.
+// - filename: file to write
+// - returns false if the file could not be written
+static bool trace_write(const char *filename)
+{
+    FILE *file = fopen(filename, "w");
+    if (!file)
+    {
+        printf("Failed to open %s\n", filename);
+        return false;
+    }
+
+    int event_count = 0;
+    int dropped_count = 0;
+    const char *separator = "";
+    double us_per_tick = 1000000.0 / trace.frequency;
+    int thread_count = SDL_AtomicGet(&trace.thread_count);
+    thread_count = thread_count < TRACE_MAX_THREADS ? thread_count : TRACE_MAX_THREADS;
+
+    fprintf(file, "{\"traceEvents\": [\n");
+    for (int i = 0; i < thread_count; ++i)
+    {
+        const struct Trace_Thread *thread = trace.threads[i];
+        if (!thread)
+        {
+            continue;
+        }
+
+        unsigned long tid = thread->id;
+        if (thread->name)
+        {
+            fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %lu, \"args\": {\"name\": \"%s\"}}",
+                    separator, tid, thread->name);
+            separator = ",\n";
+        }
+
+        for (int e = 0; e < thread->count; ++e)
+        {
+            const struct Trace_Event *event = thread->events + e;
+            double ts = (double)(event->start - trace.start) * us_per_tick;
+            if (event->counter)
+            {
+                fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": 1, \"args\": {\"count\": %llu}}",
+                        separator, event->name, ts, (unsigned long long)event->value);
+            }
+            else
+            {
+                fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %lu}",
+                        separator, event->name, ts, (double)event->value * us_per_tick, tid);
+            }
+            separator = ",\n";
+        }
+        event_count += thread->count;
+        dropped_count += thread->dropped_count;
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("trace: %d events written to %s, %d dropped\n", event_count, filename, dropped_count);
+    return true;
+}
+
+// Function to release the event buffers
+static void trace_free(void)
+{
+    for (int i = 0; i < TRACE_MAX_THREADS; ++i)
+    {
+        free(trace.threads[i]);
+        trace.threads[i] = 0;
+    }
+}
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_COUNT(counter)
+#define TRACE_COUNT_N(counter, n)
+#define TRACE_CALL(counter, call) call
+
+static void trace_init(void)
+{
+}
+
+static void trace_thread_name(const char *name)
+{
+    (void)name;
+}
+
+static void trace_frame_end(void)
+{
+}
+
+static bool trace_write(const char *filename)
+{
+    (void)filename;
+    return true;
+}
+
+static void trace_free(void)
+{
+}
+
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <stdbool.h>
+
+#include "include/SDL2/SDL.h"
+
+// Lock-free triple buffer for one writer thread and one reader thread.
+// The writer fills the back slot and publishes it by swapping it with the
+// middle slot; the reader swaps the middle slot with its front slot when a new
+// one was published. Neither side ever waits for the other, and the reader
+// always sees the most recently completed slot.
+
+#define TRIPLE_BUFFER_INDEX_MASK 3
+#define TRIPLE_BUFFER_FRESH 4
+
+struct Triple_Buffer
+{
+    void *slots[3];
+
+    // Index of the middle slot, with TRIPLE_BUFFER_FRESH set when it is unread
+    SDL_atomic_t middle;
+
+    // Owned by the writer
+    int back;
+
+    // Owned by the reader
+    int front;
+};
+
+static void triple_buffer_init(struct Triple_Buffer *buffer, void *slot0, void *slot1, void *slot2)
+{
+    buffer->slots[0] = slot0;
+    buffer->slots[1] = slot1;
+    buffer->slots[2] = slot2;
+    buffer->back = 0;
+    SDL_AtomicSet(&buffer->middle, 1);
+    buffer->front = 2;
+}
+
+// Function to get the slot the writer may fill
+static void *triple_buffer_back(struct Triple_Buffer *buffer)
+{
+    return buffer->slots[buffer->back];
+}
+
+// Function to hand the filled back slot over to the reader
+static void triple_buffer_publish(struct Triple_Buffer *buffer)
+{
+    // SDL_AtomicSet is a full barrier, the slot contents are visible before the index
+    int previous = SDL_AtomicSet(&buffer->middle, buffer->back | TRIPLE_BUFFER_FRESH);
+    buffer->back = previous & TRIPLE_BUFFER_INDEX_MASK;
+}
+
+// Function to take the most recently published slot as the front slot
+// - returns false if nothing was published since the last call
+static bool triple_buffer_acquire(struct Triple_Buffer *buffer)
+{
+    if (!(SDL_AtomicGet(&buffer->middle) & TRIPLE_BUFFER_FRESH))
+    {
+        return false;
+    }
+
+    int previous = SDL_AtomicSet(&buffer->middle, buffer->front);
+    buffer->front = previous & TRIPLE_BUFFER_INDEX_MASK;
+    return true;
+}
+
+// Function to get the slot the reader may read
+static void *triple_buffer_front(struct Triple_Buffer *buffer)
+{
+    return buffer->slots[buffer->front];
+}
+
+#endif